@@ -13,14 +13,56 @@
 
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #include <vector>
 #include <queue>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <limits>
+#include <atomic>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/io.hpp>
+#ifdef ALIGNSW_LIBRARY
+#include "alignsw.h"
+#endif
 
 #define GAP_PENALTY 2
 #define MATCH_BONUS 1 
+#define AA_GAP_PENALTY 6    // translated search, per residue
 
 using namespace std;
 using namespace boost::numeric::ublas;
@@ -47,255 +89,5400 @@ private:
     std::chrono::time_point<clock_> beg_;
 };
 
+/*
+ * hardware counters (--perf) from perf_event_open(2): each is opened on
+ * its own for the calling thread, user space only, so an event this CPU
+ * or kernel lacks is reported n/a instead of failing the rest.  counts
+ * are scaled for multiplexing.  mark() ends a phase: its counts since
+ * the previous mark() are kept with its name and DP cells
+ */
+#define PERF_EVENTS 8
+
+const char *PERF_NAMES[PERF_EVENTS] = { "cycles", "instructions", "L1d misses", "LLC misses",
+                                        "branch misses", "stalled front", "stalled back", "dTLB misses" };
+
+struct PerfSample {
+    long v[PERF_EVENTS];        // -1: not available
+    long cells;
+
+    PerfSample() : cells(0) { std::fill(v, v + PERF_EVENTS, -1L); }
+
+    void add(const PerfSample &o) {
+        for (int e = 0; e < PERF_EVENTS; e++)
+            if (o.v[e] >= 0)
+                v[e] = std::max(v[e], 0L) + o.v[e];
+        cells += o.cells;
+    }
+};
+
+class PerfCounters {
+public:
+    PerfCounters() {
+        const uint64_t rd_miss = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        const uint32_t type[PERF_EVENTS] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+        const uint64_t config[PERF_EVENTS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_L1D | rd_miss, PERF_COUNT_HW_CACHE_LL | rd_miss,
+            PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND,
+            PERF_COUNT_HW_STALLED_CYCLES_BACKEND, PERF_COUNT_HW_CACHE_DTLB | rd_miss };
+
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            perf_event_attr pe;
+            memset(&pe, 0, sizeof pe);
+            pe.size = sizeof pe;
+            pe.type = type[e];
+            pe.config = config[e];
+            pe.exclude_kernel = 1;
+            pe.exclude_hv = 1;
+            pe.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fd_[e] = syscall(SYS_perf_event_open, &pe, 0, -1, -1, 0);
+        }
+        last_ = now();
+    }
+
+    ~PerfCounters() {
+        for (int e = 0; e < PERF_EVENTS; e++)
+            if (fd_[e] >= 0)
+                close(fd_[e]);
+    }
+
+    bool available() const {
+        for (int e = 0; e < PERF_EVENTS; e++)
+            if (fd_[e] >= 0)
+                return true;
+        return false;
+    }
+
+        // close the current phase
+    void mark(const string &phase, long cells) {
+        PerfSample cur = now();
+        PerfSample d;
+        for (int e = 0; e < PERF_EVENTS; e++)
+            if (cur.v[e] >= 0)
+                d.v[e] = cur.v[e] - std::max(last_.v[e], 0L);
+        d.cells = cells;
+        phases_.push_back(make_pair(phase, d));
+        last_ = cur;
+    }
+
+        // append suffix to the last n phases' names, e.g. for a pass
+        // whose result was thrown away
+    void relabel(int n, const string &suffix) {
+        for (int k = std::max<int>(0, phases_.size() - n); k < (int) phases_.size(); k++)
+            phases_[k].first += suffix;
+    }
+
+    const std::vector<pair<string, PerfSample>> &phases() const { return phases_; }
+
+private:
+    PerfSample now() const {
+        PerfSample p;
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            uint64_t r[3];      // value, time enabled, time running
+            if (fd_[e] >= 0 && ::read(fd_[e], r, sizeof r) == sizeof r && r[2] > 0)
+                p.v[e] = (long) ((double) r[0] * r[1] / r[2]);
+        }
+        return p;
+    }
+
+    int fd_[PERF_EVENTS];
+    PerfSample last_;
+    std::vector<pair<string, PerfSample>> phases_;
+};
+
+/*
+ * one line of derived figures: IPC, per-cell events, stalled fractions
+ * returns: [string]
+ */
+string perfLine(const string &phase, const PerfSample &p) {
+    auto ratio = [](long a, long b, const char *fmt) {
+        char buf[32];
+        if (a < 0 || b <= 0)
+            return string("n/a");
+        snprintf(buf, sizeof buf, fmt, (double) a / b);
+        return string(buf);
+    };
+    const long *v = p.v;
+    string line = "perf " + phase + ": IPC " + ratio(v[1], v[0], "%.2f");
+    if (p.cells > 0) {
+        line += "  cells " + std::to_string(p.cells);
+        line += "  cycles/cell " + ratio(v[0], p.cells, "%.3f");
+        line += "  L1d/cell " + ratio(v[2], p.cells, "%.5f");
+        line += "  LLC/cell " + ratio(v[3], p.cells, "%.6f");
+        line += "  br-miss/cell " + ratio(v[4], p.cells, "%.5f");
+        line += "  dTLB/cell " + ratio(v[7], p.cells, "%.6f");
+    } else {
+        line += "  " + string(PERF_NAMES[2]) + " " + (v[2] < 0 ? "n/a" : std::to_string(v[2]));
+        line += "  " + string(PERF_NAMES[3]) + " " + (v[3] < 0 ? "n/a" : std::to_string(v[3]));
+        line += "  " + string(PERF_NAMES[7]) + " " + (v[7] < 0 ? "n/a" : std::to_string(v[7]));
+    }
+    line += "  stalled front " + ratio(v[5] < 0 ? -1 : 100 * v[5], v[0], "%.1f%%");
+    line += " back " + ratio(v[6] < 0 ? -1 : 100 * v[6], v[0], "%.1f%%");
+    return line;
+}
+
+/*
+ * every phase of pc, then their total (per cell of the largest phase,
+ * since phases of one run pass over the same cells)
+ */
+void perfReport(ostream &out, const PerfCounters &pc) {
+    if (! pc.available()) {
+        out << "perf: no counters (perf_event_paranoid, or no PMU in this VM)" << endl;
+        return;
+    }
+    PerfSample total;
+    long cells = 0;
+    for (auto &ph : pc.phases()) {
+        out << perfLine(ph.first, ph.second) << endl;
+        total.add(ph.second);
+        cells = std::max(cells, ph.second.cells);
+    }
+    total.cells = cells;
+    if (pc.phases().size() > 1)
+        out << perfLine("total", total) << endl;
+}
+
+/*
+ * large DP buffers (traceback matrices, direction stores) go on 2 MiB
+ * pages: mode "thp" maps them 2 MiB aligned and asks for transparent
+ * huge pages, "hugetlb" takes them from the hugetlbfs pool and falls
+ * back to thp when the pool is empty, "off" allocates as before.
+ * everything else, and everything in mode off, is cache-line aligned
+ */
+#define HUGE_PAGE (2L << 20)
+#define CACHE_LINE 64
+
+class HugePages {
+public:
+    static void setMode(const string &mode) { state().mode = mode; }
+
+    static void *allocate(size_t bytes) {
+        State &st = state();
+        void *p = nullptr;
+        if (bytes >= (size_t) HUGE_PAGE && st.mode != "off") {
+            size_t len = roundUp(bytes);
+            bool tlb = false;
+            if (st.mode == "hugetlb") {
+                p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                tlb = p != MAP_FAILED;
+                if (! tlb)
+                    st.fallbacks++;
+            }
+            if (! tlb)
+                p = mapAligned(len);
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+            std::lock_guard<std::mutex> lock(st.mtx);
+            st.maps[(uintptr_t) p] = len;
+            st.tlb_bytes += tlb ? len : 0;
+            return p;
+        }
+        if (posix_memalign(&p, CACHE_LINE, std::max(bytes, (size_t) 1)) != 0)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    static void deallocate(void *p, size_t bytes) {
+        State &st = state();
+        if (bytes >= (size_t) HUGE_PAGE && st.mode != "off") {
+            size_t len = roundUp(bytes);
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                st.maps.erase((uintptr_t) p);
+            }
+            munmap(p, len);
+        }
+        else
+            free(p);
+    }
+
+        // whether any buffer is on huge-page mappings now
+    static bool used() {
+        State &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        return ! st.maps.empty();
+    }
+
+        // live mappings, and how much of them the kernel backs with
+        // huge pages (AnonHugePages + Private_Hugetlb of /proc/self/smaps;
+        // a mapping merged with a neighbour counts the neighbour too)
+    static string stats() {
+        State &st = state();
+        std::lock_guard<std::mutex> lock(st.mtx);
+        size_t mapped = 0;
+        for (auto &m : st.maps)
+            mapped += m.second;
+
+        size_t huge = 0;
+        std::ifstream smaps("/proc/self/smaps");
+        string line;
+        bool ours = false;
+        while (getline(smaps, line)) {
+            unsigned long beg, end;
+            size_t kb;
+            if (sscanf(line.c_str(), "%lx-%lx ", &beg, &end) == 2) {
+                auto it = st.maps.lower_bound(end);
+                ours = it != st.maps.begin() && (--it)->first + it->second > beg;
+            }
+            else if (ours && (sscanf(line.c_str(), "AnonHugePages: %zu kB", &kb) == 1 ||
+                              sscanf(line.c_str(), "Private_Hugetlb: %zu kB", &kb) == 1))
+                huge += kb << 10;
+        }
+        huge = std::min(huge, mapped);
+
+        string text = "huge pages (" + st.mode + "): " + std::to_string(mapped >> 20) + " MiB in "
+                    + std::to_string(st.maps.size()) + " mappings, "
+                    + std::to_string(huge >> 20) + " MiB on 2 MiB pages";
+        if (st.mode == "hugetlb")
+            text += " (hugetlbfs " + std::to_string(st.tlb_bytes >> 20) + " MiB, fallbacks "
+                  + std::to_string(st.fallbacks) + ")";
+        return text;
+    }
+
+private:
+    struct State {
+        string mode = "thp";
+        std::mutex mtx;
+        std::map<uintptr_t, size_t> maps;  // start -> length, live
+        size_t tlb_bytes = 0;              // ever taken from hugetlbfs
+        long fallbacks = 0;
+    };
+
+    static State &state() {
+        static State st;
+        return st;
+    }
+
+    static size_t roundUp(size_t bytes) { return (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1); }
+
+        // anonymous, 2 MiB aligned so every huge page can be a whole
+        // one; overmap by a page and trim both ends
+    static void *mapAligned(size_t len) {
+        char *raw = (char *) mmap(nullptr, len + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return MAP_FAILED;
+        char *p = (char *) (((uintptr_t) raw + HUGE_PAGE - 1) & ~(uintptr_t) (HUGE_PAGE - 1));
+        if (p > raw)
+            munmap(raw, p - raw);
+        munmap(p + len, raw + HUGE_PAGE - p);
+        madvise(p, len, MADV_HUGEPAGE);
+        return p;
+    }
+};
+
+/*
+ * allocator for DP rows and buffers, through HugePages
+ */
+template <class T>
+struct huge_allocator : std::allocator<T> {
+    template <class U> struct rebind { typedef huge_allocator<U> other; };
+
+    huge_allocator() {}
+    template <class U> huge_allocator(const huge_allocator<U> &) {}
+
+    T *allocate(size_t n) { return (T *) HugePages::allocate(n * sizeof(T)); }
+    void deallocate(T *p, size_t n) { HugePages::deallocate(p, n * sizeof(T)); }
+};
+
+template <class T>
+using row_buffer = std::vector<T, huge_allocator<T>>;
+
+/*
+ * allocator that leaves element construction to whoever first writes
+ * it, so allocating a matrix touches none of its pages
+ */
+template <class T>
+struct first_touch_allocator : huge_allocator<T> {
+    template <class U> struct rebind { typedef first_touch_allocator<U> other; };
+
+    first_touch_allocator() {}
+    template <class U> first_touch_allocator(const first_touch_allocator<U> &) {}
+
+    template <class U, class... Args> void construct(U *, Args &&...) {}
+};
+
+/*
+ * traceback sources, one byte per cell: 1 = N, 2 = NW, 3 = W (the
+ * codes of alignWindowBy()); traceback() rebuilds coordinates with
+ * source()
+ */
+typedef matrix<unsigned char, row_major,
+               unbounded_array<unsigned char, first_touch_allocator<unsigned char>>> dir_matrix;
+
+template <class Cell>
+using sim_matrix = matrix<Cell, row_major, unbounded_array<Cell, first_touch_allocator<Cell>>>;
+
+/*
+ * compressed input: gzip, BGZF and (built with HAVE_ZSTD) zstd, told
+ * apart by their first bytes
+ */
+#define INFLATE_THREADS 4       // BGZF / zstd decoders per input
+#define INFLATE_CHUNK (1 << 20) // bytes per pipeline slot
+#define INFLATE_SLOTS 16        // slots decoded or in flight at most
+#define BGZF_GROUP 16           // BGZF blocks per slot (up to 1 MiB out)
+
+enum InputKind { INPUT_RAW, INPUT_GZIP, INPUT_BGZF, INPUT_ZSTD };
+
+/*
+ * returns: [InputKind] the format that starts with p[0..n)
+ */
+InputKind sniffInput(const unsigned char *p, size_t n) {
+    if (n >= 2 && p[0] == 0x1f && p[1] == 0x8b) {
+        if (n >= 16 && (p[3] & 4) && p[12] == 'B' && p[13] == 'C' && p[14] == 2 && p[15] == 0)
+            return INPUT_BGZF;
+        return INPUT_GZIP;
+    }
+    if (n >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+        return INPUT_ZSTD;
+    return INPUT_RAW;
+}
+
+/*
+ * total length of the BGZF block at p, from its BC extra subfield,
+ * given the first n bytes of it
+ * returns: [size_t] 0 if n is too short to tell
+ */
+size_t bgzfBlockSize(const unsigned char *p, size_t n) {
+    if (n < 12)
+        return 0;
+    size_t xlen = p[10] | p[11] << 8;
+    if (n < 12 + xlen)
+        return 0;
+    for (size_t k = 12; k + 4 <= 12 + xlen; k += 4 + (p[k+2] | p[k+3] << 8))
+        if (p[k] == 'B' && p[k+1] == 'C' && p[k+2] == 2 && k + 6 <= 12 + xlen)
+            return (p[k+4] | p[k+5] << 8) + 1;
+    cerr << "\nbgzfBlockSize() error: block without a BC subfield.\n";
+    exit(-1);
+}
+
+/*
+ * stream buffer over a (possibly compressed) file descriptor.  a reader
+ * thread cuts the input into slots in file order: raw bytes and plain
+ * gzip (which can only be decoded serially) are decoded on the reader
+ * itself; whole BGZF blocks and zstd frames are handed to a pool of
+ * decoder threads.  at most INFLATE_SLOTS slots are held, so the
+ * parser pulls decoded bytes from a bounded pipeline and never waits on
+ * decompression unless it outruns all the decoders together
+ */
+class InflateBuf : public std::streambuf {
+public:
+    explicit InflateBuf(int fd) : fd_(fd), beg_(0), end_(0), in_eof_(false), eof_(false),
+                                  stop_(false) {
+        reader_ = std::thread(&InflateBuf::read, this);
+    }
+
+    ~InflateBuf() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        reader_.join();
+        for (auto &th : workers_)
+            th.join();
+        if (fd_ > 0)
+            close(fd_);
+    }
+
+protected:
+    int_type underflow() override {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        do {
+            cv_.wait(lock, [&] { return (! slots_.empty() && slots_.front()->ready) ||
+                                        (slots_.empty() && eof_); });
+            if (slots_.empty())
+                return traits_type::eof();
+            cur_ = std::move(slots_.front());
+            slots_.pop_front();
+            cv_.notify_all();       // room for the reader
+        } while (cur_->out.empty());
+
+        setg(cur_->out.data(), cur_->out.data(), cur_->out.data() + cur_->out.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    struct Slot {
+        InputKind kind;
+        std::vector<unsigned char> in;  // whole blocks / frames to decode
+        std::vector<char> out;
+        bool claimed;
+        bool ready;
+
+        explicit Slot(InputKind k) : kind(k), claimed(false), ready(false) {}
+    };
+
+    void read() {
+        fill(16);
+        InputKind kind = sniffInput(buf_.data() + beg_, end_ - beg_);
+        if (kind == INPUT_BGZF || kind == INPUT_ZSTD) {
+#ifndef HAVE_ZSTD
+            if (kind == INPUT_ZSTD) {
+                cerr << "\nInflateBuf() error: zstd input needs a build with HAVE_ZSTD.\n";
+                exit(-1);
+            }
+#endif
+            std::lock_guard<std::mutex> lock(mtx_);
+            for (int w = 0; w < INFLATE_THREADS; w++)
+                workers_.push_back(std::thread(&InflateBuf::decode, this));
+        }
+
+        if (kind == INPUT_RAW)
+            readRaw();
+        else if (kind == INPUT_GZIP)
+            readGzip();
+        else if (kind == INPUT_BGZF)
+            readBgzf();
+#ifdef HAVE_ZSTD
+        else
+            readZstd();
+#endif
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            eof_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void readRaw() {
+        while (fill(1)) {
+            std::unique_ptr<Slot> slot(new Slot(INPUT_RAW));
+            slot->out.assign(buf_.data() + beg_, buf_.data() + end_);
+            beg_ = end_;
+            if (! push(std::move(slot), true))
+                return;
+        }
+    }
+
+        // serial inflate on this thread; concatenated members allowed
+    void readGzip() {
+        z_stream zs = {};
+        if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+            cerr << "\nInflateBuf() error: inflateInit2 failed.\n";
+            exit(-1);
+        }
+        std::unique_ptr<Slot> slot(new Slot(INPUT_GZIP));
+        slot->out.resize(INFLATE_CHUNK);
+        size_t have = 0;
+        bool mid = false;       // inside a member
+
+        while (fill(1)) {
+            zs.next_in = buf_.data() + beg_;
+            zs.avail_in = end_ - beg_;
+            zs.next_out = (Bytef *) slot->out.data() + have;
+            zs.avail_out = INFLATE_CHUNK - have;
+            int rc = inflate(&zs, Z_NO_FLUSH);
+            beg_ = end_ - zs.avail_in;
+            have = INFLATE_CHUNK - zs.avail_out;
+            mid = rc != Z_STREAM_END;
+            if (rc == Z_STREAM_END)
+                inflateReset(&zs);
+            else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                cerr << "\nInflateBuf() error: corrupt gzip input (" << (zs.msg ? zs.msg : "?")
+                     << ").\n";
+                exit(-1);
+            }
+
+            if (have == INFLATE_CHUNK) {
+                if (! push(std::move(slot), true))
+                    break;
+                slot.reset(new Slot(INPUT_GZIP));
+                slot->out.resize(INFLATE_CHUNK);
+                have = 0;
+            }
+        }
+        inflateEnd(&zs);
+        if (mid && ! stop_) {
+            cerr << "\nInflateBuf() error: truncated gzip input.\n";
+            exit(-1);
+        }
+        if (slot && have) {
+            slot->out.resize(have);
+            push(std::move(slot), true);
+        }
+    }
+
+        // whole blocks, BGZF_GROUP to a slot, for the decoders
+    void readBgzf() {
+        for (;;) {
+            std::unique_ptr<Slot> slot(new Slot(INPUT_BGZF));
+            for (int b = 0; b < BGZF_GROUP && fill(18); b++) {
+                if (sniffInput(buf_.data() + beg_, end_ - beg_) != INPUT_BGZF) {
+                    cerr << "\nInflateBuf() error: gzip member that is not BGZF.\n";
+                    exit(-1);
+                }
+                fill(12 + (buf_[beg_ + 10] | buf_[beg_ + 11] << 8));
+                size_t size = bgzfBlockSize(buf_.data() + beg_, end_ - beg_);
+                if (size < 26 || ! fill(size)) {
+                    cerr << "\nInflateBuf() error: truncated BGZF block.\n";
+                    exit(-1);
+                }
+                slot->in.insert(slot->in.end(), buf_.data() + beg_, buf_.data() + beg_ + size);
+                beg_ += size;
+            }
+            if (slot->in.empty()) {
+                if (end_ > beg_) {
+                    cerr << "\nInflateBuf() error: truncated BGZF block.\n";
+                    exit(-1);
+                }
+                return;
+            }
+            if (! push(std::move(slot), false))
+                return;
+        }
+    }
+
+#ifdef HAVE_ZSTD
+        // whole frames, up to INFLATE_CHUNK of them to a slot, for the
+        // decoders; a frame too long to buffer is decoded here instead
+    void readZstd() {
+        std::unique_ptr<Slot> slot(new Slot(INPUT_ZSTD));
+        while (fill(1)) {
+            size_t size = ZSTD_findFrameCompressedSize(buf_.data() + beg_, end_ - beg_);
+            while (ZSTD_isError(size) && end_ - beg_ < 64 * (size_t) INFLATE_CHUNK &&
+                   fill(end_ - beg_ + INFLATE_CHUNK))
+                size = ZSTD_findFrameCompressedSize(buf_.data() + beg_, end_ - beg_);
+
+            if (ZSTD_isError(size)) {
+                if (in_eof_) {
+                    cerr << "\nInflateBuf() error: truncated or corrupt zstd input.\n";
+                    exit(-1);
+                }
+                if (! slot->in.empty() && ! push(std::move(slot), false))
+                    return;
+                slot.reset(new Slot(INPUT_ZSTD));
+                if (! streamZstdFrame())
+                    return;
+                continue;
+            }
+
+            slot->in.insert(slot->in.end(), buf_.data() + beg_, buf_.data() + beg_ + size);
+            beg_ += size;
+            if (slot->in.size() >= INFLATE_CHUNK) {
+                if (! push(std::move(slot), false))
+                    return;
+                slot.reset(new Slot(INPUT_ZSTD));
+            }
+        }
+        if (! slot->in.empty())
+            push(std::move(slot), false);
+    }
+
+        // one frame decoded serially on this thread
+    bool streamZstdFrame() {
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        size_t rc = 1;
+        while (rc != 0 && fill(1)) {
+            std::unique_ptr<Slot> slot(new Slot(INPUT_ZSTD));
+            slot->out.resize(INFLATE_CHUNK);
+            ZSTD_inBuffer in = { buf_.data() + beg_, end_ - beg_, 0 };
+            ZSTD_outBuffer out = { slot->out.data(), slot->out.size(), 0 };
+            while (rc != 0 && in.pos < in.size && out.pos < out.size) {
+                rc = ZSTD_decompressStream(dctx, &out, &in);
+                if (ZSTD_isError(rc)) {
+                    cerr << "\nInflateBuf() error: corrupt zstd input ("
+                         << ZSTD_getErrorName(rc) << ").\n";
+                    exit(-1);
+                }
+            }
+            beg_ += in.pos;
+            slot->out.resize(out.pos);
+            if (! push(std::move(slot), true)) {
+                ZSTD_freeDCtx(dctx);
+                return false;
+            }
+        }
+        ZSTD_freeDCtx(dctx);
+        if (rc != 0) {
+            cerr << "\nInflateBuf() error: truncated zstd frame.\n";
+            exit(-1);
+        }
+        return true;
+    }
+#endif
+
+        // decoder thread: the oldest unclaimed slot, until none can come
+    void decode() {
+        for (;;) {
+            Slot *slot = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [&] {
+                    if (stop_)
+                        return true;
+                    for (auto &sl : slots_)
+                        if (! sl->claimed) {
+                            slot = sl.get();
+                            return true;
+                        }
+                    return eof_;
+                });
+                if (! slot)
+                    return;
+                slot->claimed = true;
+            }
+
+            if (slot->kind == INPUT_BGZF)
+                decodeBgzf(*slot);
+#ifdef HAVE_ZSTD
+            else
+                decodeZstd(*slot);
+#endif
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                slot->ready = true;
+            }
+            cv_.notify_all();
+        }
+    }
+
+    static void decodeBgzf(Slot &slot) {
+        z_stream zs = {};
+        inflateInit2(&zs, -15);
+        const unsigned char *p = slot.in.data();
+        const unsigned char *e = p + slot.in.size();
+        for (size_t size; p < e; p += size) {
+            size = bgzfBlockSize(p, e - p);
+            size_t xlen = p[10] | p[11] << 8;
+            const unsigned char *t = p + size - 8;
+            uint32_t crc = t[0] | t[1] << 8 | t[2] << 16 | (uint32_t) t[3] << 24;
+            uint32_t isize = t[4] | t[5] << 8 | t[6] << 16 | (uint32_t) t[7] << 24;
+
+            size_t at = slot.out.size();
+            slot.out.resize(at + isize);
+            inflateReset(&zs);
+            zs.next_in = (Bytef *) p + 12 + xlen;
+            zs.avail_in = size - 12 - xlen - 8;
+            zs.next_out = (Bytef *) slot.out.data() + at;
+            zs.avail_out = isize;
+            if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0 ||
+                crc32(0, (const Bytef *) slot.out.data() + at, isize) != crc) {
+                cerr << "\nInflateBuf() error: corrupt BGZF block.\n";
+                exit(-1);
+            }
+        }
+        inflateEnd(&zs);
+    }
+
+#ifdef HAVE_ZSTD
+    static void decodeZstd(Slot &slot) {
+        ZSTD_DCtx *dctx = ZSTD_createDCtx();
+        ZSTD_inBuffer in = { slot.in.data(), slot.in.size(), 0 };
+        for (;;) {
+            size_t at = slot.out.size();
+            slot.out.resize(at + ZSTD_DStreamOutSize());
+            ZSTD_outBuffer out = { slot.out.data() + at, ZSTD_DStreamOutSize(), 0 };
+            size_t rc = ZSTD_decompressStream(dctx, &out, &in);
+            if (ZSTD_isError(rc)) {
+                cerr << "\nInflateBuf() error: corrupt zstd input (" << ZSTD_getErrorName(rc)
+                     << ").\n";
+                exit(-1);
+            }
+            slot.out.resize(at + out.pos);
+            if (in.pos == in.size && out.pos < out.size)
+                break;
+        }
+        ZSTD_freeDCtx(dctx);
+    }
+#endif
+
+        // queue a slot once there is room; false once stopped
+    bool push(std::unique_ptr<Slot> slot, bool ready) {
+        slot->ready = ready;
+        slot->claimed = ready;
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            cv_.wait(lock, [&] { return stop_ || slots_.size() < INFLATE_SLOTS; });
+            if (stop_)
+                return false;
+            slots_.push_back(std::move(slot));
+        }
+        cv_.notify_all();
+        return true;
+    }
+
+        // at least need unread input bytes; false if the input ends first
+    bool fill(size_t need) {
+        while (end_ - beg_ < need && ! in_eof_) {
+            if (beg_ > 0) {
+                memmove(buf_.data(), buf_.data() + beg_, end_ - beg_);
+                end_ -= beg_;
+                beg_ = 0;
+            }
+            if (buf_.size() < std::max<size_t>(need, INFLATE_CHUNK))
+                buf_.resize(std::max<size_t>(need, INFLATE_CHUNK));
+            ssize_t got = ::read(fd_, buf_.data() + end_, buf_.size() - end_);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0) {
+                cerr << "\nInflateBuf() error: read failed.\n";
+                exit(-1);
+            }
+            if (got == 0)
+                in_eof_ = true;
+            end_ += got;
+        }
+        return end_ - beg_ >= need;
+    }
+
+    int fd_;
+    std::vector<unsigned char> buf_;    // input not yet sliced (reader only)
+    size_t beg_;
+    size_t end_;
+    bool in_eof_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<std::unique_ptr<Slot>> slots_;   // in file order
+    bool eof_;          // the reader queued its last slot
+    bool stop_;
+    std::unique_ptr<Slot> cur_;         // slot the get area points into
+    std::thread reader_;
+    std::vector<std::thread> workers_;
+};
+
+/*
+ * an input file opened by name ("-" for stdin): plain files are read
+ * directly, compressed ones (and stdin) through an InflateBuf
+ */
+class InputFile {
+public:
+    explicit InputFile(const string &filename) : in_(nullptr) {
+        if (filename != "-") {
+            file_.open(filename, ios::in | ios::binary);
+            if (! file_)
+                return;
+            if (! packed(filename)) {
+                in_ = &file_;
+                return;
+            }
+            file_.close();
+        }
+
+        int fd = filename == "-" ? 0 : open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        buf_.reset(new InflateBuf(fd));
+        stream_.reset(new istream(buf_.get()));
+        in_ = stream_.get();
+    }
+
+    bool ok() const { return in_ != nullptr; }
+    istream &in() { return *in_; }
+
+        // whether the file starts with a gzip or zstd header
+    static bool packed(const string &filename) {
+        unsigned char magic[4];
+        ifstream probe(filename, ios::in | ios::binary);
+        probe.read((char *) magic, sizeof magic);
+        return sniffInput(magic, probe.gcount()) != INPUT_RAW;
+    }
+
+private:
+    ifstream file_;
+    std::unique_ptr<InflateBuf> buf_;
+    std::unique_ptr<istream> stream_;
+    istream *in_;
+};
+
 /* 
  * import a nucleotide sequence file
  * returns: [vector<char>]
  */
-std::vector<char> importSeqFile(const string &filename) {
-    // ifstream inFile(filename, ios::binary);
-    ifstream inFile(filename, ios::in);
-    std::vector<char> fileContents( (istreambuf_iterator<char>(inFile)),
-                                     istreambuf_iterator<char>() );
+std::vector<char> importSeqFile(const string &filename) {
+    InputFile inFile(filename);
+    if (! inFile.ok())
+        return std::vector<char>();
+    std::vector<char> fileContents( (istreambuf_iterator<char>(inFile.in())),
+                                     istreambuf_iterator<char>() );
+
+    return fileContents;
+}
+
+/*
+ * import a reference sequence file, FASTA or raw ("-" reads stdin);
+ * drops '>' header lines and all whitespace, unlike importSeqFile().
+ * the first header's name (if any) is stored in *name
+ * returns: [vector<char>]
+ */
+std::vector<char> loadSeqFile(const string &filename, string *name = nullptr) {
+    InputFile inFile(filename);
+    if (! inFile.ok()) {
+        cerr << "\nloadSeqFile() error: cannot open " << filename << ".\n";
+        exit(-1);
+    }
+    istream &in = inFile.in();
+
+    std::vector<char> seq;
+    string line;
+    while (getline(in, line)) {
+        if (! line.empty() && line[0] == '>') {
+            if (name && name->empty())
+                *name = line.substr(1, line.find_first_of(" \t\r", 1) - 1);
+            continue;
+        }
+        for (auto &ch : line)
+            if (! isspace((unsigned char) ch))
+                seq.push_back(ch);
+    }
+
+    return seq;
+}
+
+/*
+ * importSeqFile() (less its last char, as main() drops it) on a
+ * background thread: the buffer is sized from the file's length up
+ * front and filled in LOAD_CHUNK reads, and waitFor() blocks only until
+ * the chars asked for have arrived, so the fill can start on row i as
+ * soon as s[i-1] is in.  anything but a regular, uncompressed file is
+ * read up front
+ */
+#define LOAD_CHUNK (1 << 20)
+
+class SeqLoader {
+public:
+    explicit SeqLoader(const string &filename) : avail_(0) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) != 0 || ! S_ISREG(st.st_mode) ||
+            InputFile::packed(filename)) {
+            seq_ = importSeqFile(filename);
+            if (! seq_.empty())
+                seq_.pop_back();
+            avail_ = seq_.size();
+            return;
+        }
+
+        in_.open(filename, ios::in | ios::binary);
+        if (! in_) {
+            cerr << "\nSeqLoader() error: cannot open " << filename << ".\n";
+            exit(-1);
+        }
+        seq_.resize(st.st_size > 0 ? st.st_size - 1 : 0);
+        th_ = std::thread(&SeqLoader::load, this);
+    }
+
+    ~SeqLoader() { join(); }
+
+        // all of s; only the first waitFor()'d chars are safe to read
+    const std::vector<char> &seq() const { return seq_; }
+
+    void waitFor(long k) {
+        if (avail_.load(std::memory_order_acquire) >= k)
+            return;
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return avail_.load(std::memory_order_acquire) >= k; });
+    }
+
+        // wait for the whole file
+    const std::vector<char> &join() {
+        if (th_.joinable())
+            th_.join();
+        return seq_;
+    }
+
+private:
+    void load() {
+        long size = seq_.size();
+        for (long off = 0; off < size; ) {
+            in_.read(seq_.data() + off, std::min<long>(LOAD_CHUNK, size - off));
+            if (in_.gcount() <= 0) {
+                cerr << "\nSeqLoader() error: file shrank while reading.\n";
+                exit(-1);
+            }
+            off += in_.gcount();
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                avail_.store(off, std::memory_order_release);
+            }
+            cv_.notify_all();
+        }
+    }
+
+    std::vector<char> seq_;
+    std::atomic<long> avail_;   // chars of seq_ read so far
+    ifstream in_;
+    std::thread th_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+/*
+ * one FASTA/FASTQ record; buffers are reused between next() calls
+ */
+struct SeqRecord {
+    string name;
+    string seq;
+    string qual;    // empty for FASTA
+};
+
+/*
+ * incremental FASTA/FASTQ reader over a stream; holds at most one
+ * record (plus the stream's own buffer) in memory at any time
+ */
+class SeqReader
+{
+public:
+    SeqReader(istream &in) : in_(in), pending_(false) {}
+
+        // read the next record into rec; false at end of input
+    bool next(SeqRecord &rec) {
+        if (! pending_ && ! nextHeader())
+            return false;
+        pending_ = false;
+
+        rec.name.assign(line_, 1, line_.find_first_of(" \t", 1) - 1);
+        rec.seq.clear();
+        rec.qual.clear();
+
+        if (line_[0] == '@') {
+                // FASTQ: @name / seq / + / qual
+            getline(in_, rec.seq);
+            getline(in_, line_);
+            getline(in_, rec.qual);
+            stripCR(rec.seq);
+            stripCR(rec.qual);
+            if (line_.empty() || line_[0] != '+') {
+                cerr << "\nSeqReader::next() error: FASTQ record " << rec.name
+                     << (in_ ? " has no '+' line.\n" : " is truncated.\n");
+                exit(-1);
+            }
+            if (rec.qual.size() != rec.seq.size()) {
+                cerr << "\nSeqReader::next() error: FASTQ record " << rec.name << (in_ ?
+                        " quality length differs from its sequence.\n" : " is truncated.\n");
+                exit(-1);
+            }
+            return true;
+        }
+
+            // FASTA: '>' header, then sequence lines up to the next header
+        while (getline(in_, line_)) {
+            stripCR(line_);
+            if (! line_.empty() && line_[0] == '>') {
+                pending_ = true;
+                break;
+            }
+            for (auto &ch : line_)
+                if (! isspace((unsigned char) ch))
+                    rec.seq.push_back(ch);
+        }
+        return true;
+    }
+
+private:
+        // skip to the next '>' or '@' header line
+    bool nextHeader() {
+        while (getline(in_, line_)) {
+            stripCR(line_);
+            if (! line_.empty() && (line_[0] == '>' || line_[0] == '@'))
+                return true;
+        }
+        return false;
+    }
+
+    static void stripCR(string &str) {
+        if (! str.empty() && str.back() == '\r')
+            str.pop_back();
+    }
+
+    istream &in_;
+    string line_;
+    bool pending_;  // line_ already holds the next FASTA header
+};
+
+/*
+ * CIGAR operations, packed as (length << 4 | op) like BAM
+ */
+enum CigarOp { CIGAR_M = 0, CIGAR_I = 1, CIGAR_D = 2, CIGAR_S = 4 };
+const char CIGAR_CHARS[] = "MIDNSHP=X";
+
+/*
+ * a local alignment of t against s: 1-based matrix rows (s) and
+ * cols (t) of its first and last cells, all zero when nothing scored
+ */
+struct Alignment {
+    int score;
+    int s_beg, s_end;
+    int t_beg, t_end;
+    bool reverse;       // t was reverse-complemented; cols refer to that
+    int frame;          // translated search: +1..+3, -1..-3 (0 otherwise)
+    std::vector<uint32_t> cigar;
+
+    Alignment() : score(0), s_beg(0), s_end(0), t_beg(0), t_end(0),
+                  reverse(false), frame(0) {}
+
+        // empty result that reuses an existing CIGAR buffer
+    explicit Alignment(std::vector<uint32_t> &&buf)
+        : score(0), s_beg(0), s_end(0), t_beg(0), t_end(0), reverse(false), frame(0),
+          cigar(std::move(buf)) {
+        cigar.clear();
+    }
+};
+
+/*
+ * a borrowed run of characters, so kernels can index part of a buffer
+ */
+struct SeqView {
+    const char *data;
+    int len;
+
+    SeqView(const char *d, int n) : data(d), len(n) {}
+    const char &operator[](int i) const { return data[i]; }
+    size_t size() const { return len; }
+};
+
+/*
+ * nucleotide complement (IUPAC-aware, case kept); '?' and others unchanged
+ * returns: [char]
+ */
+char complement(char ch) {
+    switch (ch) {
+        case 'A': return 'T';  case 'a': return 't';
+        case 'C': return 'G';  case 'c': return 'g';
+        case 'G': return 'C';  case 'g': return 'c';
+        case 'T': return 'A';  case 't': return 'a';
+        case 'U': return 'A';  case 'u': return 'a';
+        case 'R': return 'Y';  case 'r': return 'y';
+        case 'Y': return 'R';  case 'y': return 'r';
+        case 'K': return 'M';  case 'k': return 'm';
+        case 'M': return 'K';  case 'm': return 'k';
+        case 'B': return 'V';  case 'b': return 'v';
+        case 'V': return 'B';  case 'v': return 'b';
+        case 'D': return 'H';  case 'd': return 'h';
+        case 'H': return 'D';  case 'h': return 'd';
+        default:  return ch;
+    }
+}
+
+/*
+ * append the reverse complement of seq to out
+ */
+void appendRevComp(string &out, const string &seq) {
+    for (auto it = seq.rbegin(); it != seq.rend(); it++)
+        out.push_back(complement(*it));
+}
+
+/*
+ * amino-acid alphabet and BLOSUM62 in that order; unknown residues
+ * score as X
+ */
+#define AA_SIZE 24
+#define AA_X 22
+#define BLOSUM62_MAX 11
+
+const char AA_ORDER[] = "ARNDCQEGHILKMFPSTWYVBZX*";
+
+const int BLOSUM62[AA_SIZE][AA_SIZE] = {
+    {  4, -1, -2, -2,  0, -1, -1,  0, -2, -1, -1, -1, -1, -2, -1,  1,  0, -3, -2,  0, -2, -1,  0, -4 },   // A
+    { -1,  5,  0, -2, -3,  1,  0, -2,  0, -3, -2,  2, -1, -3, -2, -1, -1, -3, -2, -3, -1,  0, -1, -4 },   // R
+    { -2,  0,  6,  1, -3,  0,  0,  0,  1, -3, -3,  0, -2, -3, -2,  1,  0, -4, -2, -3,  3,  0, -1, -4 },   // N
+    { -2, -2,  1,  6, -3,  0,  2, -1, -1, -3, -4, -1, -3, -3, -1,  0, -1, -4, -3, -3,  4,  1, -1, -4 },   // D
+    {  0, -3, -3, -3,  9, -3, -4, -3, -3, -1, -1, -3, -1, -2, -3, -1, -1, -2, -2, -1, -3, -3, -2, -4 },   // C
+    { -1,  1,  0,  0, -3,  5,  2, -2,  0, -3, -2,  1,  0, -3, -1,  0, -1, -2, -1, -2,  0,  3, -1, -4 },   // Q
+    { -1,  0,  0,  2, -4,  2,  5, -2,  0, -3, -3,  1, -2, -3, -1,  0, -1, -3, -2, -2,  1,  4, -1, -4 },   // E
+    {  0, -2,  0, -1, -3, -2, -2,  6, -2, -4, -4, -2, -3, -3, -2,  0, -2, -2, -3, -3, -1, -2, -1, -4 },   // G
+    { -2,  0,  1, -1, -3,  0,  0, -2,  8, -3, -3, -1, -2, -1, -2, -1, -2, -2,  2, -3,  0,  0, -1, -4 },   // H
+    { -1, -3, -3, -3, -1, -3, -3, -4, -3,  4,  2, -3,  1,  0, -3, -2, -1, -3, -1,  3, -3, -3, -1, -4 },   // I
+    { -1, -2, -3, -4, -1, -2, -3, -4, -3,  2,  4, -2,  2,  0, -3, -2, -1, -2, -1,  1, -4, -3, -1, -4 },   // L
+    { -1,  2,  0, -1, -3,  1,  1, -2, -1, -3, -2,  5, -1, -3, -1,  0, -1, -3, -2, -2,  0,  1, -1, -4 },   // K
+    { -1, -1, -2, -3, -1,  0, -2, -3, -2,  1,  2, -1,  5,  0, -2, -1, -1, -1, -1,  1, -3, -1, -1, -4 },   // M
+    { -2, -3, -3, -3, -2, -3, -3, -3, -1,  0,  0, -3,  0,  6, -4, -2, -2,  1,  3, -1, -3, -3, -1, -4 },   // F
+    { -1, -2, -2, -1, -3, -1, -1, -2, -2, -3, -3, -1, -2, -4,  7, -1, -1, -4, -3, -2, -2, -1, -2, -4 },   // P
+    {  1, -1,  1,  0, -1,  0,  0,  0, -1, -2, -2,  0, -1, -2, -1,  4,  1, -3, -2, -2,  0,  0,  0, -4 },   // S
+    {  0, -1,  0, -1, -1, -1, -1, -2, -2, -1, -1, -1, -1, -2, -1,  1,  5, -2, -2,  0, -1, -1,  0, -4 },   // T
+    { -3, -3, -4, -4, -2, -2, -3, -2, -2, -3, -2, -3, -1,  1, -4, -3, -2, 11,  2, -3, -4, -3, -2, -4 },   // W
+    { -2, -2, -2, -3, -2, -1, -2, -3,  2, -1, -1, -2, -1,  3, -3, -2, -2,  2,  7, -1, -3, -2, -1, -4 },   // Y
+    {  0, -3, -3, -3, -1, -2, -2, -3, -3,  3,  1, -2,  1, -1, -2, -2,  0, -3, -1,  4, -3, -2, -1, -4 },   // V
+    { -2, -1,  3,  4, -3,  0,  1, -1,  0, -3, -4,  0, -3, -3, -2,  0, -1, -4, -3, -3,  4,  1, -1, -4 },   // B
+    { -1,  0,  0,  1, -3,  3,  4, -2,  0, -3, -3,  1, -1, -3, -1,  0, -1, -3, -2, -2,  1,  4, -1, -4 },   // Z
+    {  0, -1, -1, -1, -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -2,  0,  0, -2, -1, -1, -1, -1, -1, -4 },   // X
+    { -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4,  1 },   // *
+};
+
+/*
+ * residue code (row of BLOSUM62) for an amino-acid letter
+ * returns: [int]
+ */
+int aaCode(char ch) {
+    const char *p = ch ? strchr(AA_ORDER, toupper((unsigned char) ch)) : nullptr;
+
+    return p ? p - AA_ORDER : AA_X;
+}
+
+/*
+ * standard genetic code, codon index 16*b1 + 4*b2 + b3 with
+ * T/U = 0, C = 1, A = 2, G = 3
+ */
+const char GENETIC_CODE[] = "FFLLSSSSYY**CC*WLLLLPPPPHHQQRRRRIIIMTTTTNNKKSSRRVVVVAAAADDEEGGGG";
+
+int baseIndex(char ch) {
+    switch (toupper((unsigned char) ch)) {
+        case 'T': case 'U': return 0;
+        case 'C': return 1;
+        case 'A': return 2;
+        case 'G': return 3;
+        default:  return -1;
+    }
+}
+
+/*
+ * translate one codon, X if it holds anything but ACGTU
+ * returns: [char]
+ */
+char translateCodon(char b1, char b2, char b3) {
+    int i1 = baseIndex(b1);
+    int i2 = baseIndex(b2);
+    int i3 = baseIndex(b3);
+    if (i1 < 0 || i2 < 0 || i3 < 0)
+        return 'X';
+
+    return GENETIC_CODE[16 * i1 + 4 * i2 + i3];
+}
+
+/*
+ * add one column to a CIGAR that is being built back to front
+ */
+void pushCigarOp(std::vector<uint32_t> &cigar, int op) {
+    if (! cigar.empty() && (int) (cigar.back() & 0xf) == op)
+        cigar.back() += 1 << 4;
+    else
+        cigar.push_back(1 << 4 | op);
+}
+
+/*
+ * buffered output: formats numbers by hand and passes stdio (or a
+ * string sink) one large block at a time instead of one insertion
+ * per field
+ */
+class BufWriter
+{
+public:
+    BufWriter(FILE *out = stdout) : out_(out), sink_(nullptr), len_(0) {}
+    BufWriter(string &sink) : out_(nullptr), sink_(&sink), len_(0) {}
+    ~BufWriter() { flush(); }
+
+    void put(char ch) {
+        if (len_ == SIZE)
+            flush();
+        buf_[len_++] = ch;
+    }
+
+    void write(const char *data, size_t n) {
+        if (len_ + n > SIZE) {
+            flush();
+            if (n > SIZE) {
+                emit(data, n);
+                return;
+            }
+        }
+        memcpy(buf_ + len_, data, n);
+        len_ += n;
+    }
+
+    void write(const string &str) { write(str.data(), str.size()); }
+
+    void writeInt(long val) {
+        char tmp[24];
+        int k = 0;
+        unsigned long mag = val < 0 ? -(unsigned long) val : val;
+        do {
+            tmp[k++] = '0' + mag % 10;
+            mag /= 10;
+        } while (mag);
+        if (val < 0)
+            tmp[k++] = '-';
+        if (len_ + k > SIZE)
+            flush();
+        while (k)
+            buf_[len_++] = tmp[--k];
+    }
+
+        // CIGAR text, "*" when empty
+    void writeCigar(const std::vector<uint32_t> &cigar) {
+        if (cigar.empty())
+            put('*');
+        for (auto op : cigar) {
+            writeInt(op >> 4);
+            put(CIGAR_CHARS[op & 0xf]);
+        }
+    }
+
+        // host byte order, for the binary record format
+    template <class T>
+    void writeRaw(const T &val) { write((const char *) &val, sizeof(val)); }
+
+    void flush() {
+        if (len_)
+            emit(buf_, len_);
+        len_ = 0;
+    }
+
+private:
+    void emit(const char *data, size_t n) {
+        if (sink_)
+            sink_->append(data, n);
+        else
+            fwrite(data, 1, n, out_);
+    }
+
+    static const size_t SIZE = 1 << 16;
+    FILE *out_;
+    string *sink_;
+    char buf_[SIZE];
+    size_t len_;
+};
+
+/*
+ * per-worker scratch reused from one alignment to the next: DP rows,
+ * window scores and directions, and the result (whose CIGAR is the
+ * route buffer).  buffers only grow past their high-water mark, so
+ * once warmed up an alignment makes no heap allocations.  around it,
+ * stream and serve reuse their read and reply buffers too, but the
+ * server's request queue and a ResultCache still allocate per entry.
+ * DP buffers start on a cache line (huge pages when large; see HugePages)
+ */
+class Arena
+{
+public:
+    Arena() : grows_(0) {}
+
+        // at least n elements of buf, contents unspecified
+    template <class T, class A>
+    T *get(std::vector<T, A> &buf, size_t n) {
+        if (buf.size() < n) {
+            buf.resize(n + n / 2);
+            grows_++;
+        }
+        return buf.data();
+    }
+
+        // count a std container that reallocated on its own
+    void noteGrow(size_t old_cap, size_t new_cap) {
+        if (old_cap != new_cap)
+            grows_++;
+    }
+
+    long grows() const { return grows_; }
+
+    row_buffer<int> row;                // localScores()
+    std::vector<int> ends;              // localScores() segments
+    std::vector<tuple<int, int, int>> best;
+    row_buffer<int> H;                  // alignWindow()
+    row_buffer<unsigned char> dir;      // alignWindow()
+    row_buffer<int> prof;               // translated query profile
+    row_buffer<unsigned char> lim;      // QgramFilter::pass()
+    row_buffer<uint64_t> peq;           // editSearchBits() match masks
+    row_buffer<uint64_t> bits;          // editSearchBits() Pv, Mv
+    string query;                       // query, both strands
+    row_buffer<char> strands;           // strandScores() interleaved query
+    row_buffer<int16_t> diag;           // strandScores() rolling diagonals
+    row_buffer<int> segs;               // streamBatch() first segment per read
+    PerfSample perf;                    // --perf: this stream worker's counters
+    Alignment aln;
+
+private:
+    long grows_;
+};
+
+/*
+ * print a nucleotide sequence
+ */
+void printSeq(const std::vector<char> &seq) {
+    cout << "\ncontents = ";
+    for (auto &ch : seq)
+        cout << ch;
+    cout << endl;
+}
+
+/*
+ * print a uBLAS similarity matrix (any cell width)
+ */ 
+template <typename Cell>
+void printSimMatrix(const sim_matrix<Cell> &mat) {
+    for (int i = 0; i < mat.size1(); i++) {
+        for (int j = 0; j < mat.size2(); j++) {
+                cout << (int) mat(i, j) << " ";
+        }
+        cout << endl;
+    }
+}
+
+/*
+ * print a direction matrix (N, NW, W; border cells as .)
+ */
+void printDirMatrix(const dir_matrix &mat) {
+    const char *names[] = { ".", "N", "NW", "W" };
+    for (int i = 0; i < (int) mat.size1(); i++) {
+        for (int j = 0; j < (int) mat.size2(); j++)
+            cout << (i && j ? names[mat(i, j)] : names[0]) << " ";
+        cout << endl;
+    }
+}
+
+/*
+ * retrieve S-W score for a North cell, minus GAP_PENALTY
+ * returns: [int]
+ */
+template <typename Cell>
+int North(const sim_matrix<Cell> &smat, int row, int col) { 
+    if (row == 0 || col == 0) {
+        cerr << "\nNorth() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1);
+    }
+
+    // North-adjusted row
+    int adjRow = row - 1;
+
+    return smat(adjRow, col) - GAP_PENALTY;
+}
+
+/*
+ * retrieve S-W score for a West cell, minus GAP_PENALTY
+ * returns: [int]
+ */
+template <typename Cell>
+int West(const sim_matrix<Cell> &smat, int row, int col) {
+    if (row == 0 || col == 0) {
+        cerr << "\nWest() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1); 
+    }
+
+    // West-adjusted col
+    int adjCol = col - 1;
+
+    return smat(row, adjCol) - GAP_PENALTY;
+}
+
+/*
+ * determine if two nucleotides match, see MATCH_BONUS
+ * returns: [int]
+ */
+int similarity(const std::vector<char> &s, 
+               const std::vector<char> &t, 
+               int row, int col) {
+    
+    if (row == 0 || col == 0) {
+        cerr << "\nsimilarity() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1); 
+    }
+
+        // s and t are 0-indexed
+    if ( (s[row-1] == t[col-1]) || s[row-1] == '?' || t[col-1] == '?' )
+        return MATCH_BONUS;
+    else
+        return MATCH_BONUS * -1;
+}
+
+/*
+ * return a Smith-Waterman score for a NorthWest cell
+ * returns: [int]
+ */
+template <typename Cell>
+int NorthWest(const sim_matrix<Cell> &smat,
+              const std::vector<char> &s,
+              const std::vector<char> &t,
+              int row, int col) {
+
+    if (row == 0 || col == 0) {
+        cerr << "\nNorthWest() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1); 
+    }
+
+    // North-West adjustment
+    int adjRow = row - 1;
+    int adjCol = col - 1;
+
+    return smat(adjRow, adjCol) + similarity(s, t, row, col);
+}
+
+/*
+ * compute the source cell for a Smith-Waterman score
+ * return [tuple<int, int>]
+ */
+tuple<int, int> source(int idx, int row, int col) {
+    if (row == 0 || col == 0) {
+        cerr << "\nsource() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1); 
+    }
+
+    switch (idx) {
+        case 0:     // North
+            row = row - 1;
+            break;
+        case 1:     // NW
+            row = row - 1;
+            col = col - 1;
+            break;
+        case 2:     // West
+            col = col - 1;
+            break;
+        default:
+            cerr << "\nsource() error: invalid index.\n";
+            break;
+    }
+
+    return make_tuple(row, col);
+}
+
+/*
+ * update Smith-Waterman score for each sim. matrix (smat) cell;
+ * also update its direction in the direction matrix (dmat).  scores
+ * past the cell type's range are stored saturated (see pairFill())
+ */
+template <typename Cell>
+void SmithWaterman(sim_matrix<Cell> &smat, dir_matrix &dmat,
+                   const std::vector<char> &s,
+                   const std::vector<char> &t,
+                   int row, int col) {
+
+    if (row == 0 || col == 0) {
+        cerr << "\nSmithWaterman() error: nucleotide coordinates cannot be zero.\n";
+        exit(-1); 
+    }
+   
+        // set up vector<int> of neighbor scores
+    std::vector<int> scores;
+    scores.push_back(North(smat, row, col));
+    scores.push_back(NorthWest(smat, s, t, row, col));
+    scores.push_back(West(smat, row, col));
+
+        // get largest neighbor score
+    auto top_score = max_element(scores.begin(), scores.end());
+    
+    if (*top_score < 0)
+        *top_score = 0;
+
+        // update similarity matrix
+    smat(row, col) = std::min(*top_score, (int) std::numeric_limits<Cell>::max());
+        
+        // get top score index; update direction matrix (source() index + 1)
+    int  top_index = distance(scores.begin(), top_score);
+    dmat(row, col) = top_index + 1;
+}
+
+/*
+ * find the largest, rightmost, lowermost score in a 
+ * uBLAS S-W similarity matrix and its [x, y] coordinates
+ * returns: [tuple<int, int, int>]
+ */
+template <typename Cell>
+tuple<int, int, int> maxScore(const sim_matrix<Cell> &smat) {
+    int s_sz = smat.size1() - 1;
+    int t_sz = smat.size2() - 1;
+    
+    int cur_max = 0;
+    int row = s_sz;
+    int col = t_sz;
+
+    for (int i = s_sz; i >= 1; i--)
+        for (int j = t_sz; j >= 1; j--) {
+            if (smat(i, j) > cur_max) {
+                cur_max = smat(i, j);
+                row = i;
+                col = j;
+            }
+        }
+
+    return make_tuple(cur_max, row, col);
+}
+
+/*
+ * trace back from the max score p through positive-scoring cells
+ * to where the local alignment begins
+ * returns: [Alignment]
+ */
+template <typename Cell>
+Alignment traceback(const sim_matrix<Cell> &smat, const dir_matrix &dmat,
+                    const tuple<int, int> &p) {
+    Alignment aln;
+    int row = get<0>(p);
+    int col = get<1>(p);
+
+    aln.score = smat(row, col);
+    if (aln.score <= 0)
+        return aln;
+
+    aln.s_end = row;
+    aln.t_end = col;
+    while (smat(row, col) > 0) {
+        aln.s_beg = row;
+        aln.t_beg = col;
+
+        auto src = source(dmat(row, col) - 1, row, col);
+        if (get<0>(src) == row)
+            pushCigarOp(aln.cigar, CIGAR_I);     // West: t only
+        else if (get<1>(src) == col)
+            pushCigarOp(aln.cigar, CIGAR_D);     // North: s only
+        else
+            pushCigarOp(aln.cigar, CIGAR_M);
+
+        row = get<0>(src);
+        col = get<1>(src);
+    }
+
+    std::reverse(aln.cigar.begin(), aln.cigar.end());
+    return aln;
+}
+
+/*
+ * print an Alignment's end cells and CIGAR
+ */
+void printAlignment(const Alignment &aln) {
+    BufWriter out;
+    out.write("start: [");
+    out.writeInt(aln.s_beg);
+    out.write(", ");
+    out.writeInt(aln.t_beg);
+    out.write("]  end: [");
+    out.writeInt(aln.s_end);
+    out.write(", ");
+    out.writeInt(aln.t_end);
+    out.write("]\ncigar: ");
+    out.writeCigar(aln.cigar);
+    out.put('\n');
+}
+
+#define REF_TILE 16384        // rows of s per localScores() tile
+#define MASK_CHAR '#'           // hard-masked base of s (RefMask)
+
+/*
+ * score-only Smith-Waterman of s against several queries in one sweep
+ * over s.  q holds the queries back to back and arena.ends[k] is one
+ * past the last column of query k; each query starts from its own zero
+ * column so they never interact.  s is swept in tiles of REF_TILE
+ * rows, each carried through every query's saved row before the next,
+ * so a tile comes from memory once for all of them.  uses a single
+ * rolling row kept in the arena.
+ * arena.best[k] gets (score, row, col) for query k, col counted from
+ * its own start; ties resolve exactly as in maxScore() (largest row,
+ * then column)
+ */
+template <class Ref, class Seq>
+void localScores(const Ref &s, const Seq &q, Arena &arena) {
+    int m = s.size();
+    int nseg = arena.ends.size();
+    int n = nseg ? arena.ends.back() : 0;
+
+    int *row = arena.get(arena.row, n + 1);
+    std::fill(row, row + n + 1, 0);
+
+    arena.best.clear();
+    for (int k = 0, beg = 0; k < nseg; beg = arena.ends[k++])
+        arena.best.push_back(make_tuple(0, m, arena.ends[k] - beg));
+
+    for (int lo = 1; lo <= m; lo += REF_TILE) {
+        int hi = std::min(m, lo + REF_TILE - 1);
+        for (int k = 0, beg = 0; k < nseg; beg = arena.ends[k++]) {
+            int len = arena.ends[k] - beg;
+            const char *qk = &q[beg];
+            int *rk = row + beg;
+            int cur_max = get<0>(arena.best[k]);
+            int max_row = -1;
+            int max_col = 0;
+            bool wild = memchr(qk, '?', len) != nullptr;
+            int any = 1;        // previous row has a nonzero cell
+            for (int i = lo; i <= hi; i++) {
+                char sc = s[i-1];
+
+                    // a zero row stays zero through hard-masked rows
+                    // (MASK_CHAR matches only '?'), so skip them
+                if (sc == MASK_CHAR && ! any && ! wild) {
+                    while (i < hi && s[i] == MASK_CHAR)
+                        i++;
+                    if (cur_max == 0) {
+                        max_row = i;
+                        max_col = len;
+                    }
+                    continue;
+                }
+
+                int diag = 0;
+                int west = 0;
+                any = 0;
+                for (int j = 1; j <= len; j++) {
+                    char tc = qk[j-1];
+                    int sim = (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+
+                    int score = diag + sim;
+                    score = std::max(score, rk[j] - GAP_PENALTY);
+                    score = std::max(score, west - GAP_PENALTY);
+                    score = std::max(score, 0);
+
+                    diag = rk[j];
+                    rk[j] = score;
+                    west = score;
+                    any |= score;
+
+                    if (score >= cur_max) {
+                        cur_max = score;
+                        max_row = i;
+                        max_col = j;
+                    }
+                }
+            }
+            if (max_row >= 0)
+                arena.best[k] = make_tuple(cur_max, max_row, max_col);
+        }
+    }
+}
+
+/*
+ * score-only Smith-Waterman of s against a single query t
+ * returns: [tuple<int, int, int>] (score, row, col)
+ */
+template <class Ref, class Seq>
+tuple<int, int, int> localScore(const Ref &s, const Seq &t,
+                                Arena &arena) {
+    arena.ends.assign(1, t.size());
+    localScores(s, t, arena);
+
+    return arena.best[0];
+}
+
+/*
+ * first row of s a positive-scoring path ending at (row, col) can
+ * reach: it has at most col aligned pairs worth at most max_sub each,
+ * and each deletion costs gap, so it spans fewer than
+ * col + col * max_sub / gap rows
+ * returns: [int]
+ */
+int windowLow(int row, int col, int max_sub, int gap) {
+    int span = col + col * max_sub / gap + 2;
+
+    return std::max(1, row - span + 1);
+}
+
+/*
+ * recover the alignment ending at (row, col) with the given score into
+ * arena.aln.  only the windowLow() rows of s are refilled, with per-cell
+ * directions (0 = zero, 1 = N, 2 = NW, 3 = W; same tie order as
+ * SmithWaterman()), and traced back.  sim(s char, col) scores a pair
+ */
+template <class Ref, class Sim>
+void alignWindowBy(const Ref &s, int score, int row, int col,
+                   int gap, int max_sub, Sim sim, Arena &arena) {
+    Alignment &aln = arena.aln;
+    aln = Alignment(std::move(aln.cigar));
+    aln.score = score;
+    if (score <= 0)
+        return;
+
+    int lo = windowLow(row, col, max_sub, gap);
+    int nrows = row - lo + 1;
+    int w = col + 1;
+
+    size_t cells = (size_t) (nrows + 1) * w;
+    int *H = arena.get(arena.H, cells);
+    unsigned char *dir = arena.get(arena.dir, cells);
+
+        // only the border needs zeroing; everything else is written
+    std::fill(H, H + w, 0);
+    std::fill(dir, dir + w, 0);
+    for (int r = 1; r <= nrows; r++) {
+        H[(size_t) r * w] = 0;
+        dir[(size_t) r * w] = 0;
+    }
+
+    for (int r = 1; r <= nrows; r++) {
+        char sc = s[lo + r - 2];
+        int *up = &H[(size_t) (r - 1) * w];
+        int *cur = &H[(size_t) r * w];
+        unsigned char *d = &dir[(size_t) r * w];
+        for (int j = 1; j <= col; j++) {
+            int best = up[j] - gap;
+            unsigned char from = 1;
+            if (up[j-1] + sim(sc, j) > best) {
+                best = up[j-1] + sim(sc, j);
+                from = 2;
+            }
+            if (cur[j-1] - gap > best) {
+                best = cur[j-1] - gap;
+                from = 3;
+            }
+            if (best <= 0) {
+                best = 0;
+                from = 0;
+            }
+            cur[j] = best;
+            d[j] = from;
+        }
+    }
+
+    if (H[(size_t) nrows * w + col] != score) {
+        cerr << "\nalignWindow() error: window score does not match.\n";
+        exit(-1);
+    }
+
+    aln.s_end = row;
+    aln.t_end = col;
+    int r = nrows;
+    int j = col;
+    while (dir[(size_t) r * w + j] != 0) {
+        aln.s_beg = lo + r - 1;
+        aln.t_beg = j;
+        switch (dir[(size_t) r * w + j]) {
+            case 1:
+                pushCigarOp(aln.cigar, CIGAR_D);
+                r--;
+                break;
+            case 2:
+                pushCigarOp(aln.cigar, CIGAR_M);
+                r--;
+                j--;
+                break;
+            case 3:
+                pushCigarOp(aln.cigar, CIGAR_I);
+                j--;
+                break;
+        }
+    }
+
+    std::reverse(aln.cigar.begin(), aln.cigar.end());
+}
+
+/*
+ * alignWindowBy() for nucleotides: MATCH_BONUS / GAP_PENALTY scoring
+ * with '?' matching anything
+ */
+template <class Ref, class Seq>
+void alignWindow(const Ref &s, const Seq &t,
+                 int score, int row, int col, Arena &arena) {
+    auto sim = [&t](char sc, int j) {
+        char tc = t[j-1];
+        return (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+    };
+
+    alignWindowBy(s, score, row, col, GAP_PENALTY, MATCH_BONUS, sim, arena);
+}
+
+/*
+ * --strand both score-only sweep: the forward query and its reverse
+ * complement interleaved in the int16 lanes of an anti-diagonal fill
+ * (even lanes forward, odd reverse), so each load of s serves both
+ * strands and an SSE2 instruction advances 4 cells of each.  diagonals
+ * are indexed by query column, so the three rolling ones hold
+ * 2 (n + 1) lanes however long s is.  q holds the forward query then
+ * its reverse complement, n chars each; arena.best gets (score, row,
+ * col) per strand exactly as localScores() with ends {n, 2n} would
+ * returns: [bool] false (nothing done) without SSE2, or when a score
+ * could overflow an int16 lane
+ */
+bool strandScores(const char *s, int m, const char *q, int n, Arena &arena) {
+#ifdef __SSE2__
+    if ((long) MATCH_BONUS * n > std::numeric_limits<int16_t>::max())
+        return false;
+
+    char *qi = arena.get(arena.strands, 2 * n);
+    for (int j = 0; j < n; j++) {
+        qi[2 * j] = q[j];
+        qi[2 * j + 1] = q[n + j];
+    }
+
+        // lane 2j + x holds column j of strand x; each diagonal starts
+        // on a cache line and has room for the zero past its last cell
+    int w = (2 * (n + 2) + CACHE_LINE / 2 - 1) & ~(CACHE_LINE / 2 - 1);
+    int16_t *H2 = arena.get(arena.diag, 3 * w);     // diagonal d-2
+    int16_t *H1 = H2 + w;                           // d-1
+    int16_t *H0 = H1 + w;                           // d
+    std::fill(H2, H2 + 3 * w, 0);
+
+    int best[2] = { 0, 0 };
+    int brow[2] = { m, m };
+    int bcol[2] = { n, n };
+
+    const __m128i gap = _mm_set1_epi16(GAP_PENALTY);
+    const __m128i mis = _mm_set1_epi16(-MATCH_BONUS);
+    const __m128i hit = _mm_set1_epi16(2 * MATCH_BONUS);
+    const __m128i wild = _mm_set1_epi8('?');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int d = 2; d <= m + n; d++) {
+        int lo = std::max(1, d - m);
+        int hi = std::min(n, d - 1);
+        __m128i vmx = zero;
+        int mx[2] = { 0, 0 };
+
+        int j = lo;
+        for (; j + 4 <= hi + 1; j += 4) {
+                // s chars of rows d-j .. d-j-3, each for both strands
+            uint32_t s4;
+            memcpy(&s4, s + d - j - 4, 4);
+            __m128i sv = _mm_cvtsi32_si128(__builtin_bswap32(s4));
+            sv = _mm_unpacklo_epi8(sv, sv);
+            __m128i qv = _mm_loadl_epi64((const __m128i *) (qi + 2 * (j - 1)));
+            __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(sv, qv),
+                         _mm_or_si128(_mm_cmpeq_epi8(sv, wild), _mm_cmpeq_epi8(qv, wild)));
+            eq = _mm_unpacklo_epi8(eq, eq);
+            __m128i sim = _mm_add_epi16(mis, _mm_and_si128(eq, hit));
+
+            __m128i v = _mm_sub_epi16(_mm_loadu_si128((const __m128i *) (H1 + 2 * j)), gap);
+            v = _mm_max_epi16(v, _mm_add_epi16(_mm_loadu_si128((const __m128i *) (H2 + 2 * (j - 1))), sim));
+            v = _mm_max_epi16(v, _mm_sub_epi16(_mm_loadu_si128((const __m128i *) (H1 + 2 * (j - 1))), gap));
+            v = _mm_max_epi16(v, zero);
+            _mm_storeu_si128((__m128i *) (H0 + 2 * j), v);
+            vmx = _mm_max_epi16(vmx, v);
+        }
+        for (; j <= hi; j++) {
+            char sc = s[d - j - 1];
+            for (int x = 0; x < 2; x++) {
+                char tc = qi[2 * (j - 1) + x];
+                int sim = (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+                int v = std::max(H2[2 * (j - 1) + x] + sim, 0);
+                v = std::max(v, H1[2 * j + x] - GAP_PENALTY);
+                v = std::max(v, H1[2 * (j - 1) + x] - GAP_PENALTY);
+                H0[2 * j + x] = v;
+                mx[x] = std::max(mx[x], v);
+            }
+        }
+        H0[2 * (hi + 1)] = 0;       // row 0 when hi = d - 1
+        H0[2 * (hi + 1) + 1] = 0;
+
+        int16_t lanes[8];
+        _mm_storeu_si128((__m128i *) lanes, vmx);
+        for (int k = 0; k < 8; k++)
+            mx[k & 1] = std::max(mx[k & 1], (int) lanes[k]);
+
+            // rescan only a diagonal that may hold a strand's best cell
+        for (int x = 0; x < 2; x++)
+            if (mx[x] > 0 && mx[x] >= best[x])
+                for (int jj = lo; jj <= hi; jj++) {
+                    int v = H0[2 * jj + x];
+                    int i = d - jj;
+                    if (v > best[x] || (v == best[x] && (i > brow[x] || (i == brow[x] && jj > bcol[x])))) {
+                        best[x] = v;
+                        brow[x] = i;
+                        bcol[x] = jj;
+                    }
+                }
+
+        int16_t *tmp = H2;
+        H2 = H1;
+        H1 = H0;
+        H0 = tmp;
+    }
+
+    arena.best.clear();
+    for (int x = 0; x < 2; x++)
+        arena.best.push_back(make_tuple(best[x], brow[x], bcol[x]));
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*
+ * score one read on the requested strand(s) ("fwd", "rev" or "both"),
+ * then recover the best alignment into arena.aln.  both strands are
+ * scored in the same sweep over s (strandScores(), else localScores()
+ * with two segments); ties go to the forward strand
+ */
+void alignRead(const std::vector<char> &s, const string &t, const string &strand,
+               Arena &arena) {
+    size_t cap = arena.aln.cigar.capacity();
+    int n = t.size();
+
+    if (strand == "fwd") {
+        auto tup = localScore(s, t, arena);
+        alignWindow(s, t, get<0>(tup), get<1>(tup), get<2>(tup), arena);
+        arena.noteGrow(cap, arena.aln.cigar.capacity());
+        return;
+    }
+
+    size_t qcap = arena.query.capacity();
+    arena.query.clear();
+    if (strand == "both")
+        arena.query += t;
+    appendRevComp(arena.query, t);
+    arena.noteGrow(qcap, arena.query.capacity());
+
+    if (strand != "both" || ! strandScores(s.data(), s.size(), arena.query.data(), n, arena)) {
+        arena.ends.clear();
+        if (strand == "both")
+            arena.ends.push_back(n);
+        arena.ends.push_back(arena.query.size());
+        localScores(s, arena.query, arena);
+    }
+
+    bool rev = (strand == "rev") || get<0>(arena.best[1]) > get<0>(arena.best[0]);
+    auto tup = arena.best[rev ? arena.best.size() - 1 : 0];
+    SeqView view(arena.query.data() + (rev ? arena.query.size() - n : 0), n);
+
+    alignWindow(s, view, get<0>(tup), get<1>(tup), get<2>(tup), arena);
+    arena.aln.reverse = rev;
+    arena.noteGrow(cap, arena.aln.cigar.capacity());
+}
+
+/*
+ * Smith-Waterman state that grows with its inputs: keeps only the last
+ * column (H(i, n), all rows) and last row (H(m, j), all columns) plus
+ * the running best, so appending k query chars costs O(m k) and
+ * appending k reference chars O(n k) instead of a fresh O(m n) fill.
+ * best() is kept up to date at no extra cost; align() is not, it refills
+ * the best cell's window (up to O(m n)) and is meant for occasional use.
+ * scores, ties and traceback match a full fill of s x t
+ */
+class IncrementalAligner {
+public:
+    IncrementalAligner() : col_(1, 0), row_(1, 0), best_(0, 0, 0) {}
+
+        // new columns: the recurrence runs down each one from row 1
+    void appendQuery(const char *q, size_t k) {
+        int m = s_.size();
+        for (size_t c = 0; c < k; c++) {
+            char tc = q[c];
+            t_.push_back(tc);
+            int j = t_.size();
+            int diag = col_[0];
+            int north = 0;
+            for (int i = 1; i <= m; i++) {
+                char sc = s_[i-1];
+                int sim = (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+                int v = std::max(std::max(diag + sim, col_[i] - GAP_PENALTY),
+                                 std::max(north - GAP_PENALTY, 0));
+                diag = col_[i];
+                col_[i] = v;
+                north = v;
+                consider(v, i, j);
+            }
+            row_.push_back(col_[m]);
+        }
+    }
+
+        // new rows: the same, across each one from column 1
+    void appendRef(const char *r, size_t k) {
+        int n = t_.size();
+        for (size_t c = 0; c < k; c++) {
+            char sc = r[c];
+            s_.push_back(sc);
+            int i = s_.size();
+            int diag = row_[0];
+            int west = 0;
+            for (int j = 1; j <= n; j++) {
+                char tc = t_[j-1];
+                int sim = (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+                int v = std::max(std::max(diag + sim, row_[j] - GAP_PENALTY),
+                                 std::max(west - GAP_PENALTY, 0));
+                diag = row_[j];
+                row_[j] = v;
+                west = v;
+                consider(v, i, j);
+            }
+            col_.push_back(row_[n]);
+        }
+    }
+
+        // (score, row, col) as maxScore() would report it
+    tuple<int, int, int> best() const {
+        if (get<0>(best_) == 0)
+            return make_tuple(0, (int) s_.size(), (int) t_.size());
+        return best_;
+    }
+
+        // current best alignment, in arena.aln; a window refill, not O(k)
+    const Alignment &align(Arena &arena) const {
+        auto b = best();
+        alignWindow(s_, t_, get<0>(b), get<1>(b), get<2>(b), arena);
+        return arena.aln;
+    }
+
+    const std::vector<char> &ref() const { return s_; }
+    const std::vector<char> &query() const { return t_; }
+
+private:
+        // largest score, then largest row, then column
+    void consider(int v, int i, int j) {
+        int bs = get<0>(best_);
+        if (v > 0 && (v > bs || (v == bs && (i > get<1>(best_) ||
+                                            (i == get<1>(best_) && j > get<2>(best_))))))
+            best_ = make_tuple(v, i, j);
+    }
+
+    std::vector<char> s_;
+    std::vector<char> t_;
+    std::vector<int> col_;      // H(0..m, n)
+    std::vector<int> row_;      // H(m, 0..n)
+    tuple<int, int, int> best_;
+};
+
+/*
+ * unit-cost edit scoring (--scoring edit): the fewest substitutions,
+ * insertions and deletions that place all of query t somewhere in s.
+ * hits are (distance, last row of s), leftmost on ties
+ */
+struct EditHit {
+    int dist;
+    int end;
+};
+
+/*
+ * Sellers' column DP over the query for each char of s
+ * returns: [EditHit]
+ */
+template <class Ref, class Seq>
+EditHit editSearchScalar(const Ref &s, const Seq &t, Arena &arena) {
+    int m = s.size();
+    int n = t.size();
+    int *col = arena.get(arena.row, n + 1);
+    for (int i = 0; i <= n; i++)
+        col[i] = i;
+
+    EditHit hit = { n, 0 };
+    for (int j = 1; j <= m; j++) {
+        char sc = s[j-1];
+        int diag = 0;       // D(0, j-1); row 0 is free
+        for (int i = 1; i <= n; i++) {
+            char tc = t[i-1];
+            int sub = (sc == tc || sc == '?' || tc == '?') ? 0 : 1;
+            int v = std::min(diag + sub, std::min(col[i] + 1, col[i-1] + 1));
+            diag = col[i];
+            col[i] = v;
+        }
+        if (col[n] < hit.dist) {
+            hit.dist = col[n];
+            hit.end = j;
+        }
+    }
+    return hit;
+}
+
+/*
+ * one 64-row block of Myers' bit-vector column step (Hyyro's
+ * formulation): vertical deltas in Pv/Mv, Eq the rows matching this
+ * char of s, hin the horizontal delta entering the block's top
+ * returns: [int] the horizontal delta leaving its bottom
+ */
+inline int myersBlock(uint64_t &Pv, uint64_t &Mv, uint64_t Eq, int hin) {
+    uint64_t hneg = hin < 0 ? 1 : 0;
+    uint64_t hpos = hin > 0 ? 1 : 0;
+    uint64_t Xv = Eq | Mv;
+    Eq |= hneg;
+    uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+    uint64_t Ph = Mv | ~(Xh | Pv);
+    uint64_t Mh = Pv & Xh;
+
+    int hout = (int) (Ph >> 63) - (int) (Mh >> 63);
+    Ph = Ph << 1 | hpos;
+    Mh = Mh << 1 | hneg;
+    Pv = Mh | ~(Xv | Ph);
+    Mv = Ph & Xv;
+    return hout;
+}
+
+/*
+ * the same search, 64 query rows per machine word: the query is cut
+ * into ceil(n / 64) blocks, each carrying its bottom distance, with
+ * the horizontal delta of each block's last row feeding the next
+ * returns: [EditHit]
+ */
+template <class Ref, class Seq>
+EditHit editSearchBits(const Ref &s, const Seq &t, Arena &arena) {
+    int m = s.size();
+    int n = t.size();
+    EditHit hit = { n, 0 };
+    if (n == 0)
+        return hit;
+    int W = (n + 63) / 64;
+
+        // per-char match masks; '?' in the query matches every char
+    uint64_t *peq = arena.get(arena.peq, 257 * W);
+    uint64_t *any = peq + 256 * W;
+    std::fill(any, any + W, 0);
+    for (int i = 0; i < n; i++)
+        if (t[i] == '?')
+            any[i / 64] |= uint64_t(1) << (i % 64);
+    for (int c = 0; c < 256; c++)
+        std::copy(any, any + W, peq + c * W);
+    for (int i = 0; i < n; i++)
+        peq[(unsigned char) t[i] * W + i / 64] |= uint64_t(1) << (i % 64);
+    std::fill(peq + (unsigned char) '?' * W, peq + (unsigned char) '?' * W + W, ~uint64_t(0));
+
+    uint64_t *Pv = arena.get(arena.bits, 2 * W);
+    uint64_t *Mv = Pv + W;
+    int *score = arena.get(arena.row, W);
+    for (int b = 0; b < W; b++) {
+        Pv[b] = ~uint64_t(0);
+        Mv[b] = 0;
+        score[b] = 64 * (b + 1);
+    }
+
+        // the last block's rows past n are padding: undo their deltas
+    int last = (n - 1) % 64;
+    uint64_t pad = last == 63 ? 0 : ~uint64_t(0) << (last + 1);
+
+    for (int j = 1; j <= m; j++) {
+        const uint64_t *eq = peq + (unsigned char) s[j-1] * W;
+        int h = 0;      // row 0 is free
+        for (int b = 0; b < W; b++) {
+            h = myersBlock(Pv[b], Mv[b], eq[b], h);
+            score[b] += h;
+        }
+        int d = score[W-1] - __builtin_popcountll(Pv[W-1] & pad)
+                           + __builtin_popcountll(Mv[W-1] & pad);
+        if (d < hit.dist) {
+            hit.dist = d;
+            hit.end = j;
+        }
+    }
+    return hit;
+}
+
+/*
+ * recover the alignment of a hit into arena.aln (score = distance):
+ * a small DP over just the rows of s it can span, diagonal steps
+ * preferred on ties
+ */
+template <class Ref, class Seq>
+void editTraceback(const Ref &s, const Seq &t, EditHit hit, Arena &arena) {
+    size_t cap = arena.aln.cigar.capacity();
+    arena.aln = Alignment(std::move(arena.aln.cigar));
+    Alignment &aln = arena.aln;
+    int n = t.size();
+    aln.score = hit.dist;
+    if (hit.end == 0 || n == 0)
+        return;
+
+    int lo = std::max(1, hit.end - n - hit.dist);     // first usable row
+    int rows = hit.end - lo + 1;
+    int *D = arena.get(arena.H, (rows + 1) * (n + 1));
+    unsigned char *dir = arena.get(arena.dir, (rows + 1) * (n + 1));
+
+        // D[r][i]: query prefix i ending at row lo + r - 1 of s
+    for (int i = 0; i <= n; i++) {
+        D[i] = i;
+        dir[i] = 1;
+    }
+    for (int r = 1; r <= rows; r++) {
+        char sc = s[lo + r - 2];
+        int *cur = D + r * (n + 1);
+        int *up = cur - (n + 1);
+        unsigned char *dr = dir + r * (n + 1);
+        cur[0] = 0;
+        dr[0] = 0;
+        for (int i = 1; i <= n; i++) {
+            char tc = t[i-1];
+            int sub = (sc == tc || sc == '?' || tc == '?') ? 0 : 1;
+            int v = up[i-1] + sub;
+            unsigned char d = 2;
+            if (cur[i-1] + 1 < v) {
+                v = cur[i-1] + 1;   // query char only
+                d = 1;
+            }
+            if (up[i] + 1 < v) {
+                v = up[i] + 1;      // ref char only
+                d = 3;
+            }
+            cur[i] = v;
+            dr[i] = d;
+        }
+    }
+
+    int r = rows;
+    int i = n;
+    aln.s_end = hit.end;
+    aln.t_end = n;
+    aln.t_beg = 1;
+    while (i > 0) {
+        int d = dir[r * (n + 1) + i];
+        if (d == 2) {
+            pushCigarOp(aln.cigar, CIGAR_M);
+            r--;
+            i--;
+        } else if (d == 1) {
+            pushCigarOp(aln.cigar, CIGAR_I);
+            i--;
+        } else {
+            pushCigarOp(aln.cigar, CIGAR_D);
+            r--;
+        }
+    }
+    aln.s_beg = lo + r;
+    std::reverse(aln.cigar.begin(), aln.cigar.end());
+    arena.noteGrow(cap, aln.cigar.capacity());
+}
+
+/*
+ * edit-scoring counterpart of alignRead(): the bit-vector engine
+ * unless engine is "scalar"; ties go to the forward strand
+ */
+void alignEdit(const std::vector<char> &s, const string &t, const string &strand,
+               const string &engine, Arena &arena) {
+    auto search = [&](const SeqView &q) {
+        return engine == "scalar" ? editSearchScalar(s, q, arena) : editSearchBits(s, q, arena);
+    };
+    int n = t.size();
+
+    size_t qcap = arena.query.capacity();
+    arena.query.assign(t);
+    if (strand != "fwd")
+        appendRevComp(arena.query, t);
+    arena.noteGrow(qcap, arena.query.capacity());
+
+    SeqView fwd(arena.query.data(), n);
+    SeqView rc(arena.query.data() + arena.query.size() - n, n);
+    EditHit hit = { n + 1, 0 };
+    if (strand != "rev")
+        hit = search(fwd);
+    bool rev = false;
+    if (strand != "fwd") {
+        EditHit h = search(rc);
+        if (h.dist < hit.dist) {
+            hit = h;
+            rev = true;
+        }
+    }
+
+    editTraceback(s, rev ? rc : fwd, hit, arena);
+    arena.aln.reverse = rev;
+}
+
+/*
+ * advance a rolling row by reference row i, the column scores of that
+ * row's residue coming from a profile row; best kept as in localScores()
+ */
+inline void advanceRow(int *row, const int *prof, int n, int gap, int i,
+                       tuple<int, int, int> &best) {
+    int cur_max = get<0>(best);
+    int max_row = -1;
+    int max_col = 0;
+    int diag = 0;
+    int west = 0;
+
+    for (int j = 1; j <= n; j++) {
+        int score = diag + prof[j];
+        score = std::max(score, row[j] - gap);
+        score = std::max(score, west - gap);
+        score = std::max(score, 0);
+
+        diag = row[j];
+        row[j] = score;
+        west = score;
+
+        if (score >= cur_max) {
+            cur_max = score;
+            max_row = i;
+            max_col = j;
+        }
+    }
+
+    if (max_row >= 0)
+        best = make_tuple(cur_max, max_row, max_col);
+}
+
+/*
+ * BLOSUM62 profile of protein query q into arena.prof: row c holds the
+ * score of residue code c against every column of q
+ */
+void buildProfile(const string &q, Arena &arena) {
+    int n = q.size();
+    int *prof = arena.get(arena.prof, AA_SIZE * (n + 1));
+
+    for (int c = 0; c < AA_SIZE; c++) {
+        prof[c * (n + 1)] = 0;
+        for (int j = 1; j <= n; j++)
+            prof[c * (n + 1) + j] = BLOSUM62[c][aaCode(q[j-1])];
+    }
+}
+
+/*
+ * score the protein profile in arena.prof (n columns) against all six
+ * reading frames of s without a translated copy: one forward and one
+ * reverse-complement sweep over s, in which every nucleotide completes
+ * a codon in exactly one of the sweep's three frames and that frame's
+ * rolling row advances by one residue.  best[] gets (score, residue
+ * row, col) for frames +1, +2, +3, -1, -2, -3
+ */
+void translatedScores(const std::vector<char> &s, int n, Arena &arena,
+                      tuple<int, int, int> best[6]) {
+    int m = s.size();
+    const int *prof = arena.prof.data();
+    int *rows = arena.get(arena.row, 3 * (n + 1));
+
+    for (int strand = 0; strand < 2; strand++) {
+        std::fill(rows, rows + 3 * (n + 1), 0);
+        int nres[3] = { 0, 0, 0 };
+        for (int f = 0; f < 3; f++)
+            best[3 * strand + f] = make_tuple(0, std::max(0, (m - f) / 3), n);
+
+        char b1 = 0;
+        char b2 = 0;
+        for (int p = 0; p < m; p++) {
+            char b3 = strand ? complement(s[m-1-p]) : s[p];
+            if (p >= 2) {
+                int f = (p - 2) % 3;
+                int code = aaCode(translateCodon(b1, b2, b3));
+                advanceRow(rows + f * (n + 1), prof + code * (n + 1), n, AA_GAP_PENALTY,
+                           ++nres[f], best[3 * strand + f]);
+            }
+            b1 = b2;
+            b2 = b3;
+        }
+    }
+}
+
+/*
+ * view of a window of residue codes as if it were indexed from the
+ * start of the frame
+ */
+struct OffsetView {
+    const char *data;
+    int offset;
+
+    OffsetView(const char *d, int off) : data(d), offset(off) {}
+    char operator[](int i) const { return data[i - offset]; }
+};
+
+/*
+ * translated search of protein query q against the six frames of s;
+ * the best frame (ties to the earlier of +1..+3, -1..-3) is traced
+ * back through just its window of residues and mapped back to
+ * nucleotide coordinates of s in arena.aln.  CIGAR lengths count
+ * residues
+ */
+void alignTranslated(const std::vector<char> &s, const string &q, Arena &arena) {
+    size_t cap = arena.aln.cigar.capacity();
+    int m = s.size();
+    int n = q.size();
+
+    buildProfile(q, arena);
+    tuple<int, int, int> best[6];
+    translatedScores(s, n, arena, best);
+
+    int fi = 0;
+    for (int k = 1; k < 6; k++)
+        if (get<0>(best[k]) > get<0>(best[fi]))
+            fi = k;
+    int score = get<0>(best[fi]);
+    int row = get<1>(best[fi]);
+    int col = get<2>(best[fi]);
+    int f = fi % 3;
+    bool rev = fi >= 3;
+
+        // residue codes of the window's rows in this frame
+    int lo = windowLow(row, col, BLOSUM62_MAX, AA_GAP_PENALTY);
+    size_t qcap = arena.query.capacity();
+    arena.query.clear();
+    if (score > 0)
+        for (int r = lo; r <= row; r++) {
+            int p = f + 3 * (r - 1);    // first base, 0-based on this strand
+            char b[3];
+            for (int k = 0; k < 3; k++)
+                b[k] = rev ? complement(s[m-1-(p+k)]) : s[p+k];
+            arena.query.push_back(aaCode(translateCodon(b[0], b[1], b[2])));
+        }
+    arena.noteGrow(qcap, arena.query.capacity());
+
+    const int *prof = arena.prof.data();
+    auto sim = [prof, n](char code, int j) { return prof[code * (n + 1) + j]; };
+    alignWindowBy(OffsetView(arena.query.data(), lo - 1), score, row, col,
+                  AA_GAP_PENALTY, BLOSUM62_MAX, sim, arena);
+
+    Alignment &aln = arena.aln;
+    aln.frame = rev ? -(f + 1) : f + 1;
+    if (score > 0) {
+        int beg = f + 3 * (aln.s_beg - 1) + 1;     // 1-based on this strand
+        int end = f + 3 * aln.s_end;
+        aln.s_beg = rev ? m - end + 1 : beg;
+        aln.s_end = rev ? m - beg + 1 : end;
+    }
+    arena.noteGrow(cap, aln.cigar.capacity());
+}
+
+/*
+ * q-gram prefilter for --min-score.  if the longest prefix of the query
+ * from position j found exactly in s has L bases, a run of matches
+ * through j ends within L-1 columns, closed by a mismatch, a gap or the
+ * end of the alignment.  a short DP over the query under that rule
+ * (match +1, mismatch -1, gap -2 per run) bounds every local score from
+ * above, so a query whose bound falls under the minimum is never
+ * aligned.  L is looked up for QGRAM_MIN..QGRAM_MAX, shorter ones are
+ * assumed present and QGRAM_MAX means unbounded; q-grams with anything
+ * but ACGT in the query count as present, a wildcard in s turns the
+ * filter off
+ */
+#define QGRAM_MIN 6
+#define QGRAM_MAX 12
+
+class QgramFilter {
+public:
+    explicit QgramFilter(const std::vector<char> &s) : off_(false) {
+        for (char ch : s)
+            if (ch == '?')
+                off_ = true;
+        for (int q = QGRAM_MIN; q <= QGRAM_MAX && ! off_; q++) {
+            uint64_t mask = (uint64_t(1) << 2 * q) - 1;
+            bits_[q].assign((mask >> 6) + 1, 0);
+            uint64_t code = 0;
+            int run = 0;    // ACGT bases ending here
+            for (char ch : s) {
+                int b = baseCode(ch);
+                run = b < 0 ? 0 : run + 1;
+                code = (code << 2 | (b & 3)) & mask;
+                if (run >= q)
+                    bits_[q][code >> 6] |= uint64_t(1) << (code & 63);
+            }
+        }
+    }
+
+        // can t (n bases, on the given strand(s)) reach min_score?
+        // lim is scratch space
+    bool pass(const char *t, int n, const string &strand, int min_score,
+              row_buffer<unsigned char> &lim) const {
+        if (off_ || min_score <= 0)
+            return true;
+        if (n < min_score)
+            return false;
+        if (strand != "rev" && bound(t, n, false, lim) >= min_score)
+            return true;
+        return strand != "fwd" && bound(t, n, true, lim) >= min_score;
+    }
+
+private:
+    static int baseCode(char ch) {
+        switch (ch) {
+            case 'A': return 0;
+            case 'C': return 1;
+            case 'G': return 2;
+            case 'T': return 3;
+            default:  return -1;
+        }
+    }
+
+        // upper bound on any local score of t (reverse complement when
+        // rev) against s
+    int bound(const char *t, int n, bool rev, row_buffer<unsigned char> &lim) const {
+        lim.assign(n, QGRAM_MIN - 1);
+
+            // lim[j]: longest run of matches that can start at j
+        uint64_t code = 0;
+        int run = 0;
+        for (int i = 0; i < n; i++) {
+            int b = baseCode(rev ? complement(t[n-1-i]) : t[i]);
+            run = b < 0 ? 0 : run + 1;
+            code = code << 2 | (b & 3);
+            for (int q = QGRAM_MIN; q <= QGRAM_MAX && q <= i + 1; q++) {
+                uint64_t c = code & ((uint64_t(1) << 2 * q) - 1);
+                if (run < q || (bits_[q][c >> 6] >> (c & 63) & 1))
+                    lim[i-q+1] = std::max<int>(lim[i-q+1], q);
+            }
+        }
+
+        const int NEG = -(1 << 28);
+        int free = NEG;         // run unbounded
+        int owed[QGRAM_MAX];    // owed[k]: at most k more matches in this run
+        for (int k = 0; k < QGRAM_MAX - 1; k++)
+            owed[k] = NEG;
+        int best = 0;
+
+        for (int j = 0; j < n; j++) {
+            int any = free;
+            for (int k = 0; k < QGRAM_MAX - 1; k++)
+                any = std::max(any, owed[k]);
+            int open = std::max(std::max(free, any - 2), 0);    // gap or fresh start
+            int more = n - j <= lim[j] ? QGRAM_MAX : lim[j] - 1;
+
+            int nfree = std::max(any, open) - 1;                // mismatch at j
+            int nowed[QGRAM_MAX];
+            for (int k = 0; k < QGRAM_MAX - 1; k++)
+                nowed[k] = NEG;
+            for (int k = 1; k < QGRAM_MAX - 1; k++) {
+                int r = std::min(k - 1, more);
+                nowed[r] = std::max(nowed[r], owed[k] + 1);
+            }
+            if (more >= QGRAM_MAX - 1)
+                nfree = std::max(nfree, std::max(free, open) + 1);
+            else
+                nowed[more] = std::max(nowed[more], std::max(free, open) + 1);
+
+            free = nfree;
+            best = std::max(best, free);
+            for (int k = 0; k < QGRAM_MAX - 1; k++) {
+                owed[k] = nowed[k];
+                best = std::max(best, owed[k]);
+            }
+        }
+
+        return best;
+    }
+
+    std::vector<uint64_t> bits_[QGRAM_MAX + 1];
+    bool off_;
+};
+
+/*
+ * write one read's result in the selected output format.  read
+ * coordinates are on the read as given, even for reverse-strand hits;
+ * the CIGAR always runs along the reference
+ *   tsv: name  length  score  ref_beg  ref_end  read_beg  read_end
+ *        strand (+/-, or frame +1..-3 when translated)  cigar
+ *   sam: SAM record, soft-clipped, score in AS:i
+ *   bin: int32 score, ref_beg, ref_end, read_beg, read_end;
+ *        uint32 flags (SAM bits 4, 16; signed frame in bits 16-23),
+ *        read length, name length,
+ *        CIGAR op count; name bytes; CIGAR ops as uint32
+ *        (length << 4 | BAM op code)
+ */
+void writeResult(BufWriter &out, const string &format, const string &refName,
+                 const SeqRecord &rec, const Alignment &aln) {
+    bool mapped = ! aln.cigar.empty();
+    int n = rec.seq.size();
+    int read_beg = aln.reverse && mapped ? n - aln.t_end + 1 : aln.t_beg;
+    int read_end = aln.reverse && mapped ? n - aln.t_beg + 1 : aln.t_end;
+    int flags = (mapped ? 0 : 4) | (aln.reverse || aln.frame < 0 ? 16 : 0)
+              | (aln.frame & 0xff) << 16;
+
+    if (format == "bin") {
+        int32_t coords[5] = { aln.score, aln.s_beg, aln.s_end, read_beg, read_end };
+        uint32_t sizes[4] = { (uint32_t) flags, (uint32_t) n, (uint32_t) rec.name.size(),
+                              (uint32_t) aln.cigar.size() };
+        out.write((const char *) coords, sizeof(coords));
+        out.write((const char *) sizes, sizeof(sizes));
+        out.write(rec.name);
+        if (! aln.cigar.empty())
+            out.write((const char *) aln.cigar.data(), aln.cigar.size() * sizeof(uint32_t));
+        return;
+    }
+
+    out.write(rec.name);
+    out.put('\t');
+
+    if (format == "tsv") {
+        out.writeInt(n);
+        for (int val : { aln.score, aln.s_beg, aln.s_end, read_beg, read_end }) {
+            out.put('\t');
+            out.writeInt(val);
+        }
+        out.put('\t');
+        out.put(aln.reverse || aln.frame < 0 ? '-' : '+');
+        if (aln.frame)
+            out.writeInt(std::abs(aln.frame));
+        out.put('\t');
+        out.writeCigar(aln.cigar);
+        out.put('\n');
+        return;
+    }
+
+        // sam: SEQ/QUAL are stored along the reference strand
+    out.writeInt(flags);
+    out.put('\t');
+    out.write(mapped ? refName : "*");
+    out.put('\t');
+    out.writeInt(aln.s_beg);
+    out.write(mapped ? "\t255\t" : "\t0\t");
+    if (mapped) {
+        int lclip = aln.t_beg - 1;
+        int rclip = rec.seq.size() - aln.t_end;
+        if (lclip) {
+            out.writeInt(lclip);
+            out.put('S');
+        }
+        out.writeCigar(aln.cigar);
+        if (rclip) {
+            out.writeInt(rclip);
+            out.put('S');
+        }
+    } else {
+        out.put('*');
+    }
+    out.write("\t*\t0\t0\t");
+    if (aln.reverse) {
+        for (auto it = rec.seq.rbegin(); it != rec.seq.rend(); it++)
+            out.put(complement(*it));
+        out.put('\t');
+        if (rec.qual.empty())
+            out.put('*');
+        for (auto it = rec.qual.rbegin(); it != rec.qual.rend(); it++)
+            out.put(*it);
+    } else {
+        out.write(rec.seq);
+        out.put('\t');
+        out.write(rec.qual.empty() ? "*" : rec.qual);
+    }
+    out.write("\tAS:i:");
+    out.writeInt(aln.score);
+    out.put('\n');
+}
+
+/*
+ * 64-bit hash of n bytes, a word at a time (multiply-xorshift), for
+ * result cache keys
+ * returns: [uint64_t]
+ */
+uint64_t hashBytes(const char *p, size_t n, uint64_t h) {
+    const uint64_t K = 0x9e3779b97f4a7c15ULL;
+    h ^= n * K;
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * K;
+        h ^= h >> 29;
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    h = (h ^ w) * K;
+    h ^= h >> 32;
+    return h * K ^ h >> 29;
+}
+
+/*
+ * low-complexity masking (--mask dust) of a reference: a window of
+ * DUST_WINDOW bases is masked when 10 * sum c_t (c_t - 1) / 2 over its
+ * triplet counts, divided by (triplets - 1), exceeds DUST_LEVEL.  the
+ * intervals are cached next to the reference in FILE.dust, keyed by a
+ * hash of s, and a file that does not describe sorted, disjoint runs
+ * within s is recomputed.  hard masking overwrites the bases with
+ * MASK_CHAR, which only a '?' matches; the scalar localScores() skips
+ * zeroed runs of it, while strandScores() (--strand both) sweeps them
+ * at full cost.  soft masking leaves s alone and drops hits lying mostly in masked
+ * bases
+ */
+#define DUST_WINDOW 64
+#define DUST_LEVEL 20
+
+class RefMask {
+public:
+    RefMask(const std::vector<char> &s, const string &refFile) {
+        uint64_t ref = hashBytes(s.data(), s.size(), DUST_WINDOW * 1000 + DUST_LEVEL);
+        string path = refFile + ".dust";
+        if (refFile != "-" && load(path, ref, s.size()))
+            return;
+        dust(s);
+        if (refFile != "-")
+            save(path, ref);
+    }
+
+        // overwrite every masked base of s with MASK_CHAR
+    void harden(std::vector<char> &s) const {
+        for (auto &iv : iv_)
+            std::fill(s.begin() + iv.first, s.begin() + iv.second, MASK_CHAR);
+    }
+
+        // whether over half of rows beg..end (1-based) are masked
+    bool covers(int beg, int end) const {
+        auto it = std::lower_bound(iv_.begin(), iv_.end(), (uint32_t) beg - 1,
+                                   [](const std::pair<uint32_t, uint32_t> &iv, uint32_t row) {
+                                       return iv.second <= row; });
+        long hit = 0;
+        for (; it != iv_.end() && (int) it->first < end; ++it)
+            hit += std::max<long>(0, std::min<long>(it->second, end) - std::max<long>(it->first, beg - 1));
+        return 2 * hit > end - beg + 1;
+    }
+
+    size_t intervals() const { return iv_.size(); }
+
+    long bases() const {
+        long n = 0;
+        for (auto &iv : iv_)
+            n += iv.second - iv.first;
+        return n;
+    }
+
+private:
+        // triplet counts kept for a sliding window, masked windows merged
+    void dust(const std::vector<char> &s) {
+        long m = s.size();
+        std::vector<int> trip(m, -1);   // triplet starting at each base
+        for (long i = 0; i + 2 < m; i++) {
+            int a = baseIndex(s[i]);
+            int b = baseIndex(s[i+1]);
+            int c = baseIndex(s[i+2]);
+            if (a >= 0 && b >= 0 && c >= 0)
+                trip[i] = 16 * a + 4 * b + c;
+        }
+
+        int count[64] = {};
+        long sum = 0;   // sum of c_t (c_t - 1) / 2
+        long l = 0;     // triplets in the window
+        const long span = DUST_WINDOW - 2;
+        for (long i = 0; i + 2 < m; i++) {
+            if (trip[i] >= 0) {
+                sum += count[trip[i]]++;
+                l++;
+            }
+            if (i >= span && trip[i - span] >= 0) {
+                sum -= --count[trip[i - span]];
+                l--;
+            }
+            if (l > 1 && 10 * sum > DUST_LEVEL * (l - 1)) {
+                uint32_t beg = std::max<long>(0, i - span + 1);
+                uint32_t end = i + 3;
+                if (! iv_.empty() && iv_.back().second >= beg)
+                    iv_.back().second = end;
+                else
+                    iv_.push_back(std::make_pair(beg, end));
+            }
+        }
+    }
+
+        // the header, then n intervals filling the rest of the file, each
+        // in order, non-empty and within the m bases of s
+    bool load(const string &path, uint64_t ref, size_t m) {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (! f)
+            return false;
+        struct stat st;
+        char magic[8];
+        uint64_t hash;
+        uint64_t n;
+        bool ok = fstat(fileno(f), &st) == 0
+               && fread(magic, 1, 8, f) == 8 && memcmp(magic, "ALNSWM01", 8) == 0
+               && fread(&hash, sizeof hash, 1, f) == 1 && hash == ref
+               && fread(&n, sizeof n, 1, f) == 1
+               && n == ((uint64_t) st.st_size - 24) / sizeof iv_[0]
+               && (uint64_t) st.st_size == 24 + n * sizeof iv_[0];
+        if (ok) {
+            iv_.resize(n);
+            ok = fread(iv_.data(), sizeof iv_[0], n, f) == n;
+        }
+        for (size_t k = 0; ok && k < iv_.size(); k++)
+            ok = iv_[k].first < iv_[k].second && iv_[k].second <= m
+              && (k == 0 || iv_[k-1].second <= iv_[k].first);
+        fclose(f);
+        if (! ok)
+            iv_.clear();
+        return ok;
+    }
+
+        // best effort: a read-only reference directory just means no cache
+    void save(const string &path, uint64_t ref) const {
+        string tmp = path + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "wb");
+        if (! f)
+            return;
+        uint64_t n = iv_.size();
+        bool ok = fwrite("ALNSWM01", 1, 8, f) == 8
+               && fwrite(&ref, sizeof ref, 1, f) == 1
+               && fwrite(&n, sizeof n, 1, f) == 1
+               && fwrite(iv_.data(), sizeof iv_[0], n, f) == n;
+        ok = fclose(f) == 0 && ok;
+        if (! ok || rename(tmp.c_str(), path.c_str()) != 0)
+            unlink(tmp.c_str());
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> iv_;    // [beg, end), 0-based
+};
+
+/*
+ * cache of finished Alignments keyed by a hash of (reference, mode,
+ * scoring, query): an LRU tier of up to capacity entries in memory and,
+ * given a directory, an on-disk tier of one file per key that outlives
+ * the run.  entries keep the query to rule out hash collisions
+ */
+#define CACHE_ENTRIES 65536
+
+class ResultCache {
+public:
+    ResultCache(size_t capacity, const string &dir)
+        : cap_(capacity), dir_(dir), hits_(0), disk_hits_(0), misses_(0) {}
+
+        // the mode part of a key, one scheme for every caller: "translate",
+        // or the scoring and strand, e.g. "sw/fwd"
+    static string mode(const string &scoring, const string &strand, bool translate) {
+        return translate ? string("translate") : scoring + "/" + strand;
+    }
+
+        // key for query q in the given mode() against the reference
+        // hashed as ref
+    static uint64_t key(uint64_t ref, const string &mode, const char *q, size_t n) {
+        int scoring[3] = { GAP_PENALTY, MATCH_BONUS, AA_GAP_PENALTY };
+        uint64_t h = hashBytes((const char *) scoring, sizeof scoring, ref);
+        h = hashBytes(mode.data(), mode.size(), h);
+        return hashBytes(q, n, h);
+    }
+
+        // copy a cached result for (key, q) into aln
+    bool get(uint64_t key, const char *q, size_t n, Alignment &aln) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = map_.find(key);
+            if (it != map_.end() && it->second->query.compare(0, string::npos, q, n) == 0) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                copy(it->second->aln, aln);
+                hits_++;
+                return true;
+            }
+        }
+
+        if (! dir_.empty() && readDisk(key, q, n, aln)) {
+            put(key, q, n, aln, false);
+            std::lock_guard<std::mutex> lock(mtx_);
+            disk_hits_++;
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        misses_++;
+        return false;
+    }
+
+    void put(uint64_t key, const char *q, size_t n, const Alignment &aln, bool disk = true) {
+        if (disk && ! dir_.empty())
+            writeDisk(key, q, n, aln);
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        auto it = map_.find(key);
+        if (it != map_.end()) {
+            lru_.erase(it->second);
+            map_.erase(it);
+        }
+        lru_.emplace_front();
+        lru_.front().key = key;
+        lru_.front().query.assign(q, n);
+        copy(aln, lru_.front().aln);
+        map_[key] = lru_.begin();
+
+        if (lru_.size() > cap_) {
+            map_.erase(lru_.back().key);
+            lru_.pop_back();
+        }
+    }
+
+    string stats() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return "cache hits: " + std::to_string(hits_) + "  disk hits: " + std::to_string(disk_hits_)
+             + "  misses: " + std::to_string(misses_);
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        string query;
+        Alignment aln;
+    };
+
+        // copy keeping dst's CIGAR buffer
+    static void copy(const Alignment &src, Alignment &dst) {
+        dst.score = src.score;
+        dst.s_beg = src.s_beg;
+        dst.s_end = src.s_end;
+        dst.t_beg = src.t_beg;
+        dst.t_end = src.t_end;
+        dst.reverse = src.reverse;
+        dst.frame = src.frame;
+        dst.cigar.assign(src.cigar.begin(), src.cigar.end());
+    }
+
+    string path(uint64_t key) const {
+        char name[24];
+        snprintf(name, sizeof name, "/%016llx.aln", (unsigned long long) key);
+        return dir_ + name;
+    }
+
+        // file: "ALNSWK01", uint64 query length, query, int32 score, s_beg,
+        // s_end, t_beg, t_end, reverse, frame, ncigar; then the ops
+    bool readDisk(uint64_t key, const char *q, size_t n, Alignment &aln) {
+        FILE *f = fopen(path(key).c_str(), "rb");
+        if (! f)
+            return false;
+        char magic[8];
+        uint64_t len;
+        int32_t v[8];
+        string query;
+        bool ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, "ALNSWK01", 8) == 0
+               && fread(&len, sizeof len, 1, f) == 1 && len == n;
+        if (ok) {
+            query.resize(len);
+            ok = fread(&query[0], 1, len, f) == len && query.compare(0, string::npos, q, n) == 0
+              && fread(v, sizeof v, 1, f) == 1 && v[7] >= 0;
+        }
+        if (ok) {
+            aln.score = v[0];
+            aln.s_beg = v[1];
+            aln.s_end = v[2];
+            aln.t_beg = v[3];
+            aln.t_end = v[4];
+            aln.reverse = v[5];
+            aln.frame = v[6];
+            aln.cigar.resize(v[7]);
+            ok = fread(aln.cigar.data(), sizeof(uint32_t), v[7], f) == (size_t) v[7];
+        }
+        fclose(f);
+        return ok;
+    }
+
+        // to a temporary renamed into place, so readers never see half a file;
+        // pid and a per-process counter keep concurrent writers of the same
+        // key, in this process or another, off each other's temporary
+    void writeDisk(uint64_t key, const char *q, size_t n, const Alignment &aln) {
+        static std::atomic<unsigned long> serial(0);
+        string dst = path(key);
+        string tmp = dst + "." + std::to_string(getpid()) + "." + std::to_string(serial++) + ".tmp";
+        FILE *f = fopen(tmp.c_str(), "wb");
+        if (! f)
+            return;
+        uint64_t len = n;
+        int32_t v[8] = { aln.score, aln.s_beg, aln.s_end, aln.t_beg, aln.t_end,
+                         aln.reverse, aln.frame, (int32_t) aln.cigar.size() };
+        bool ok = fwrite("ALNSWK01", 1, 8, f) == 8 && fwrite(&len, sizeof len, 1, f) == 1
+               && fwrite(q, 1, n, f) == n && fwrite(v, sizeof v, 1, f) == 1
+               && fwrite(aln.cigar.data(), sizeof(uint32_t), aln.cigar.size(), f) == aln.cigar.size();
+        ok = fclose(f) == 0 && ok;
+        if (! ok || rename(tmp.c_str(), dst.c_str()) != 0)
+            remove(tmp.c_str());
+    }
+
+    size_t cap_;
+    string dir_;
+    std::mutex mtx_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> map_;
+    long hits_;
+    long disk_hits_;
+    long misses_;
+};
+
+/*
+ * command-line options; positional arguments land in files
+ */
+struct Options {
+    bool stream;
+    bool extend;        // incremental updates instead of reads
+    string format;      // stream output: tsv, sam or bin
+    string strand;      // fwd, rev or both
+    bool translate;     // protein queries against six frames of s
+    string scoring;     // sw (local, the defines) or edit (unit-cost search)
+    string engine;      // auto, scalar (edit scoring) or simd (sw pair mode)
+    int min_score;      // report only hits scoring this much (0: all)
+    int width;          // pair mode score cells: 8, 16, 32 bits (0: auto)
+    string ooc;         // pair mode out-of-core tile file
+    bool resume;        // continue --ooc from its checkpoint
+    int checkpoint;     // seconds between --ooc checkpoints (< 0: none)
+    int procs;          // pair mode partitioned worker processes (0: off)
+    string transport;   // between them: unix, tcp or shm
+    std::vector<string> peers;  // tcp host:port per stripe (empty: fork locally)
+    int worker;         // --peers stripe this process fills (-1: coordinator)
+    string serve;       // server mode unix socket path
+    size_t cache;       // result cache entries in memory (0: no cache)
+    string cache_dir;   // result cache disk tier
+    int threads;        // stream or server workers
+    bool multi;         // stream: score each batch of reads in one sweep of s
+    string mask;        // low-complexity masking of s: none or dust
+    string mask_mode;   // hard (masked bases never match) or soft (drop hits)
+    bool perf;          // hardware counters per phase and thread
+    string hugepages;   // large DP buffers on thp, hugetlb or off
+    int prefetch;       // pair mode fill prefetch distance in cells (0: off)
+    std::vector<string> files;
+
+    Options() : stream(false), extend(false), format("tsv"), strand("fwd"), translate(false),
+                scoring("sw"), engine("auto"), min_score(0), width(0), resume(false), checkpoint(60), procs(0),
+                transport("unix"), worker(-1), cache(0), threads(1), multi(false),
+                mask("none"), mask_mode("hard"), perf(false), hugepages("thp"), prefetch(0) {}
+};
+
+void usage() {
+    cerr << "usage: align [--strand fwd|rev|both | --translate] [--min-score S]\n"
+         << "             [--width auto|8|16|32]\n"
+         << "             [--ooc tile_file [--checkpoint SECS] [--resume]]\n"
+         << "             [--procs N [--transport unix|tcp|shm | --transport tcp --peers HOST:PORT,...]]\n"
+         << "             sequence_file unknown_file\n";
+    cerr << "       align --worker K --procs N --transport tcp --peers HOST:PORT,... sequence_file unknown_file\n";
+    cerr << "       align --stream [--format tsv|sam|bin] [--threads N] [--min-score S] [--multi]\n"
+         << "             [--strand fwd|rev|both | --translate] reference_file reads_file|-\n";
+    cerr << "       align --serve socket_path [--threads N] reference_file\n";
+    cerr << "stream, serve: [--mask dust [--mask-mode hard|soft]] low-complexity masking of s\n";
+    cerr << "       align --extend reference_file updates_file|-   (lines: t BASES, s BASES, a)\n";
+    cerr << "any mode: [--cache N] [--cache-dir DIR] reuse earlier results\n";
+    cerr << "pair, stream: [--scoring sw|edit [--engine auto|scalar]] edit reports distances\n";
+    cerr << "pair: [--engine simd] anti-diagonal SIMD fill with traceback\n";
+    cerr << "pair (sw, fwd), stream: [--perf] hardware counters per phase and thread\n";
+    cerr << "pair (sw, fwd): [--prefetch CELLS] prefetch distance of the full-matrix fill\n";
+    cerr << "any mode: [--hugepages thp|hugetlb|off] large DP buffers on 2 MiB pages\n";
+    exit(-1);
+}
+
+/*
+ * parse argv into Options, exits with usage on anything unknown
+ * returns: [Options]
+ */
+Options parseArgs(int argc, char* argv[]) {
+    Options opt;
+
+    for (int k = 1; k < argc; k++) {
+        string arg = argv[k];
+        if (arg == "--stream")
+            opt.stream = true;
+        else if (arg == "--extend")
+            opt.extend = true;
+        else if (arg == "--format" && k + 1 < argc)
+            opt.format = argv[++k];
+        else if (arg == "--threads" && k + 1 < argc)
+            opt.threads = atoi(argv[++k]);
+        else if (arg == "--strand" && k + 1 < argc)
+            opt.strand = argv[++k];
+        else if (arg == "--translate")
+            opt.translate = true;
+        else if (arg == "--multi")
+            opt.multi = true;
+        else if (arg == "--perf")
+            opt.perf = true;
+        else if (arg == "--hugepages" && k + 1 < argc)
+            opt.hugepages = argv[++k];
+        else if (arg == "--prefetch" && k + 1 < argc)
+            opt.prefetch = atoi(argv[++k]);
+        else if (arg == "--mask" && k + 1 < argc)
+            opt.mask = argv[++k];
+        else if (arg == "--mask-mode" && k + 1 < argc)
+            opt.mask_mode = argv[++k];
+        else if (arg == "--scoring" && k + 1 < argc)
+            opt.scoring = argv[++k];
+        else if (arg == "--engine" && k + 1 < argc)
+            opt.engine = argv[++k];
+        else if (arg == "--min-score" && k + 1 < argc)
+            opt.min_score = atoi(argv[++k]);
+        else if (arg == "--ooc" && k + 1 < argc)
+            opt.ooc = argv[++k];
+        else if (arg == "--resume")
+            opt.resume = true;
+        else if (arg == "--procs" && k + 1 < argc)
+            opt.procs = atoi(argv[++k]);
+        else if (arg == "--transport" && k + 1 < argc)
+            opt.transport = argv[++k];
+        else if (arg == "--peers" && k + 1 < argc) {
+            string list = argv[++k];
+            for (size_t beg = 0, end; beg <= list.size(); beg = end + 1) {
+                end = std::min(list.find(',', beg), list.size());
+                opt.peers.push_back(list.substr(beg, end - beg));
+            }
+        }
+        else if (arg == "--worker" && k + 1 < argc)
+            opt.worker = atoi(argv[++k]);
+        else if (arg == "--serve" && k + 1 < argc)
+            opt.serve = argv[++k];
+        else if (arg == "--cache" && k + 1 < argc)
+            opt.cache = atol(argv[++k]);
+        else if (arg == "--cache-dir" && k + 1 < argc)
+            opt.cache_dir = argv[++k];
+        else if (arg == "--checkpoint" && k + 1 < argc)
+            opt.checkpoint = atoi(argv[++k]);
+        else if (arg == "--width" && k + 1 < argc) {
+            string w = argv[++k];
+            opt.width = w == "auto" ? 0 : atoi(w.c_str());
+            if (opt.width != 0 && opt.width != 8 && opt.width != 16 && opt.width != 32)
+                usage();
+        }
+        else if (arg.size() > 1 && arg[0] == '-')
+            if (arg == "-")
+                opt.files.push_back(arg);
+            else
+                usage();
+        else
+            opt.files.push_back(arg);
+    }
+
+    if (opt.format != "tsv" && opt.format != "sam" && opt.format != "bin")
+        usage();
+    if (opt.strand != "fwd" && opt.strand != "rev" && opt.strand != "both")
+        usage();
+    if (opt.translate && (opt.strand != "fwd" || opt.format == "sam" || opt.min_score))
+        usage();
+    if (opt.min_score < 0)
+        usage();
+    if ((opt.scoring != "sw" && opt.scoring != "edit") ||
+        (opt.engine != "auto" && opt.engine != "scalar" && opt.engine != "simd"))
+        usage();
+    if (opt.engine == "simd" && (opt.scoring != "sw" || opt.stream || ! opt.serve.empty()
+                                 || opt.extend || opt.strand != "fwd" || ! opt.ooc.empty()
+                                 || opt.procs))
+        usage();
+    if (opt.scoring == "edit" && (opt.translate || opt.min_score || opt.format == "sam"
+                                  || ! opt.serve.empty() || opt.extend || ! opt.ooc.empty()
+                                  || opt.procs))
+        usage();
+    if (opt.transport != "unix" && opt.transport != "tcp" && opt.transport != "shm")
+        usage();
+    if ((! opt.peers.empty() && (! opt.procs || opt.transport != "tcp"))
+        || (opt.worker >= 0 && opt.peers.empty()) || opt.worker < -1)
+        usage();
+    if (opt.procs < 0 || (opt.procs && (opt.stream || opt.translate || ! opt.ooc.empty()
+                                        || opt.strand != "fwd")))
+        usage();
+    if ((opt.resume && opt.ooc.empty()) ||
+        (! opt.ooc.empty() && (opt.stream || opt.translate || opt.strand != "fwd")))
+        usage();
+    if (opt.files.size() != (opt.serve.empty() ? 2u : 1u) || opt.threads < 1)
+        usage();
+    if ((opt.mask != "none" && opt.mask != "dust") ||
+        (opt.mask_mode != "hard" && opt.mask_mode != "soft") ||
+        (opt.mask != "none" && ! opt.stream && opt.serve.empty()) ||
+        (opt.mask_mode == "soft" && ! opt.stream))
+        usage();
+    if (opt.perf && (! opt.serve.empty() || opt.extend || opt.translate || opt.scoring != "sw"
+                     || ! opt.ooc.empty() || opt.procs
+                     || (! opt.stream && (opt.strand != "fwd" || opt.min_score || opt.cache))))
+        usage();
+    if (opt.hugepages != "thp" && opt.hugepages != "hugetlb" && opt.hugepages != "off")
+        usage();
+    if (opt.prefetch < 0 || (opt.prefetch && (opt.stream || ! opt.serve.empty() || opt.extend
+                                              || opt.translate || opt.scoring != "sw"
+                                              || opt.engine == "simd" || opt.strand != "fwd"
+                                              || ! opt.ooc.empty() || opt.procs)))
+        usage();
+    if (opt.multi && (! opt.stream || opt.translate || opt.scoring != "sw" || opt.cache
+                      || ! opt.cache_dir.empty()))
+        usage();
+    if (! opt.cache_dir.empty() && opt.cache == 0)
+        opt.cache = CACHE_ENTRIES;
+
+    return opt;
+}
+
+/*
+ * a batch of reads in flight between the stream reader and a worker;
+ * records and output text keep their capacity from batch to batch
+ */
+#define BATCH_READS 256
+
+struct ReadBatch {
+    std::vector<SeqRecord> recs;
+    int count;
+    int rejected;   // skipped by the prefilter
+    int below;      // aligned, but under --min-score
+    int masked;     // aligned, but mostly in soft-masked bases
+    string out;     // formatted results
+    bool done;
+};
+
+/*
+ * hand-off between the stream reader (main) and its workers
+ */
+struct StreamQueue {
+    std::mutex mtx;
+    std::condition_variable todo_cv;    // batch queued, or closed
+    std::condition_variable done_cv;    // a batch was finished
+    std::queue<ReadBatch *> todo;
+    bool closed;
+
+    StreamQueue() : closed(false) {}
+};
+
+/*
+ * --mask: find (or load the cached) low-complexity intervals of s and,
+ * for hard masking, overwrite them
+ * returns: [unique_ptr<RefMask>] empty without --mask
+ */
+std::unique_ptr<RefMask> maskReference(std::vector<char> &s, const Options &opt) {
+    std::unique_ptr<RefMask> mask;
+    if (opt.mask == "none")
+        return mask;
+    mask.reset(new RefMask(s, opt.files[0]));
+    if (opt.mask_mode == "hard")
+        mask->harden(s);
+    cerr << "masked (" << opt.mask << ", " << opt.mask_mode << "): " << mask->bases()
+         << " bases in " << mask->intervals() << " intervals" << endl;
+    return mask;
+}
+
+/*
+ * --mask-mode soft: report a hit lying mostly in masked bases unmapped
+ */
+void dropMasked(const RefMask *soft, Alignment &aln, int &masked) {
+    if (soft && aln.score > 0 && soft->covers(aln.s_beg, aln.s_end)) {
+        aln = Alignment(std::move(aln.cigar));
+        masked++;
+    }
+}
+
+/*
+ * --multi: score every read of a batch (on its strands) as segments of
+ * one localScores() sweep, so each tile of s is read once per batch
+ * rather than once per read, then trace each back as alignRead() would
+ * returns: [long] DP cells scored, prefiltered reads not included
+ */
+long streamBatch(const std::vector<char> &s, const Options &opt, const string &refName,
+                 const QgramFilter *filter, const RefMask *soft, ReadBatch &batch,
+                 Arena &arena) {
+    bool fwd = opt.strand != "rev";
+    bool rc = opt.strand != "fwd";
+
+    size_t qcap = arena.query.capacity();
+    arena.query.clear();
+    arena.ends.clear();
+    int *segs = arena.get(arena.segs, batch.count);
+    for (int k = 0; k < batch.count; k++) {
+        const string &seq = batch.recs[k].seq;
+        segs[k] = -1;
+        if (filter && ! filter->pass(seq.data(), seq.size(), opt.strand, opt.min_score, arena.lim))
+            continue;
+        segs[k] = arena.ends.size();
+        if (fwd) {
+            arena.query += seq;
+            arena.ends.push_back(arena.query.size());
+        }
+        if (rc) {
+            appendRevComp(arena.query, seq);
+            arena.ends.push_back(arena.query.size());
+        }
+    }
+    arena.noteGrow(qcap, arena.query.capacity());
+    localScores(s, arena.query, arena);
+
+    BufWriter out(batch.out);
+    for (int k = 0; k < batch.count; k++) {
+        int seg = segs[k];
+        if (seg < 0) {
+            arena.aln = Alignment(std::move(arena.aln.cigar));
+            batch.rejected++;
+        } else {
+            int n = batch.recs[k].seq.size();
+            bool rev = ! fwd || (rc && get<0>(arena.best[seg+1]) > get<0>(arena.best[seg]));
+            if (rev && fwd)
+                seg++;
+
+            auto tup = arena.best[seg];
+            SeqView view(arena.query.data() + arena.ends[seg] - n, n);
+            size_t cap = arena.aln.cigar.capacity();
+            alignWindow(s, view, get<0>(tup), get<1>(tup), get<2>(tup), arena);
+            arena.aln.reverse = rev;
+            arena.noteGrow(cap, arena.aln.cigar.capacity());
+            if (arena.aln.score < opt.min_score) {
+                arena.aln = Alignment(std::move(arena.aln.cigar));
+                batch.below++;
+            }
+        }
+        dropMasked(soft, arena.aln, batch.masked);
+        writeResult(out, opt.format, refName, batch.recs[k], arena.aln);
+    }
+    return (long) s.size() * arena.query.size();
+}
+
+/*
+ * stream worker: align batches with its own arena until the queue closes
+ */
+void streamWorker(const std::vector<char> &s, const Options &opt, const string &refName,
+                  const QgramFilter *filter, const RefMask *soft, ResultCache *cache, uint64_t ref,
+                  StreamQueue &q, Arena &arena) {
+    std::unique_ptr<PerfCounters> perf;
+    if (opt.perf)
+        perf.reset(new PerfCounters);
+    long cells = 0;
+    int strands = opt.strand == "both" ? 2 : 1;
+
+    for (;;) {
+        ReadBatch *batch;
+        {
+            std::unique_lock<std::mutex> lock(q.mtx);
+            q.todo_cv.wait(lock, [&] { return ! q.todo.empty() || q.closed; });
+            if (q.todo.empty())
+                break;
+            batch = q.todo.front();
+            q.todo.pop();
+        }
+        batch->out.clear();
+        batch->rejected = 0;
+        batch->below = 0;
+        batch->masked = 0;
+        if (opt.multi) {
+            cells += streamBatch(s, opt, refName, filter, soft, *batch, arena);
+        } else {
+            BufWriter out(batch->out);
+            for (int k = 0; k < batch->count; k++) {
+                const string &seq = batch->recs[k].seq;
+                const string &mode = ResultCache::mode(opt.scoring, opt.strand, opt.translate);
+                uint64_t key = 0;
+                bool hit = false;
+                if (cache) {
+                    key = ResultCache::key(ref, mode, seq.data(), seq.size());
+                    hit = cache->get(key, seq.data(), seq.size(), arena.aln);
+                }
+
+                if (opt.translate) {
+                    if (! hit) {
+                        alignTranslated(s, seq, arena);
+                        if (cache)
+                            cache->put(key, seq.data(), seq.size(), arena.aln);
+                    }
+                } else if (! hit && filter && ! filter->pass(seq.data(), seq.size(), opt.strand,
+                                                             opt.min_score, arena.lim)) {
+                    arena.aln = Alignment(std::move(arena.aln.cigar));
+                    batch->rejected++;
+                } else {
+                    if (! hit) {
+                            // only reads that reach a kernel count as work
+                        cells += (long) strands * s.size() * seq.size();
+                        if (opt.scoring == "edit")
+                            alignEdit(s, seq, opt.strand, opt.engine, arena);
+                        else
+                            alignRead(s, seq, opt.strand, arena);
+                        if (cache)
+                            cache->put(key, seq.data(), seq.size(), arena.aln);
+                    }
+                    if (arena.aln.score < opt.min_score) {
+                        arena.aln = Alignment(std::move(arena.aln.cigar));
+                        batch->below++;
+                    }
+                }
+                dropMasked(soft, arena.aln, batch->masked);
+                writeResult(out, opt.format, refName, batch->recs[k], arena.aln);
+            }
+            out.flush();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(q.mtx);
+            batch->done = true;
+        }
+        q.done_cv.notify_all();
+    }
+
+    if (perf) {
+        perf->mark("align", cells);
+        arena.perf = perf->phases().back().second;
+    }
+}
+
+/*
+ * streaming mode: load the reference once, then align each FASTA/FASTQ
+ * read from the reads file ("-" for stdin) as it arrives, writing one
+ * result per read (see writeResult()) to stdout in input order.  at
+ * most 2 * threads batches of BATCH_READS reads are held at a time.
+ * with --min-score, reads the q-gram prefilter rules out are never
+ * aligned, and those and any scoring under it are reported unmapped
+ */
+void streamReads(const Options &opt) {
+    Timer tmr;
+
+    const string &refFilNam = opt.files[0];
+    const string &readFilNam = opt.files[1];
+
+        // counters for this thread (input, output); workers keep their own
+    std::unique_ptr<PerfCounters> perf;
+    if (opt.perf)
+        perf.reset(new PerfCounters);
+
+    string refName;
+    std::vector<char> s = loadSeqFile(refFilNam, &refName);
+    if (refName.empty())
+        refName = refFilNam;
+    cerr << "REFERENCE(S): " << refFilNam << " size: " << s.size() << endl;
+    if (perf)
+        perf->mark("load reference", 0);
+    std::unique_ptr<RefMask> mask = maskReference(s, opt);
+
+    InputFile inFile(readFilNam);
+    if (! inFile.ok()) {
+        cerr << "\nstreamReads() error: cannot open " << readFilNam << ".\n";
+        exit(-1);
+    }
+    SeqReader reader(inFile.in());
+
+    BufWriter out;
+    if (opt.format == "sam") {
+        out.write("@HD\tVN:1.6\tSO:unsorted\n@SQ\tSN:");
+        out.write(refName);
+        out.write("\tLN:");
+        out.writeInt(s.size());
+        out.write("\n@PG\tID:align\tPN:align\n");
+    } else if (opt.format == "bin") {
+        out.write("ALNSWB02", 8);
+    }
+
+    std::unique_ptr<QgramFilter> filter;
+    if (opt.min_score > 0)
+        filter.reset(new QgramFilter(s));
+    std::unique_ptr<ResultCache> cache;
+    if (opt.cache)
+        cache.reset(new ResultCache(opt.cache, opt.cache_dir));
+    uint64_t ref = hashBytes(s.data(), s.size(), 0);
+    if (perf)
+        perf->mark("mask, filter, cache setup", 0);
+
+    StreamQueue q;
+    std::vector<Arena> arenas(opt.threads);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < opt.threads; w++)
+        workers.push_back(std::thread(streamWorker, std::cref(s), std::cref(opt),
+                                      std::cref(refName), filter.get(),
+                                      opt.mask_mode == "soft" ? mask.get() : nullptr, cache.get(), ref,
+                                      std::ref(q), std::ref(arenas[w])));
+
+    std::vector<ReadBatch> batches(2 * opt.threads);
+    std::vector<ReadBatch *> idle;
+    std::deque<ReadBatch *> inflight;      // in input order
+    for (auto &b : batches)
+        idle.push_back(&b);
+
+    long nreads = 0;
+    long nbases = 0;
+    long rejected = 0;
+    long below = 0;
+    long masked = 0;
+    bool eof = false;
+
+    for (;;) {
+            // refill every idle batch from the input
+        while (! eof && ! idle.empty()) {
+            ReadBatch *b = idle.back();
+            if (b->recs.size() < BATCH_READS)
+                b->recs.resize(BATCH_READS);
+            b->count = 0;
+            while (b->count < BATCH_READS && reader.next(b->recs[b->count])) {
+                nbases += b->recs[b->count].seq.size();
+                b->count++;
+            }
+            if (b->count < BATCH_READS)
+                eof = true;
+            if (b->count == 0)
+                break;
+
+            nreads += b->count;
+            idle.pop_back();
+            b->done = false;
+            {
+                std::lock_guard<std::mutex> lock(q.mtx);
+                q.todo.push(b);
+            }
+            q.todo_cv.notify_one();
+            inflight.push_back(b);
+        }
+
+        if (inflight.empty())
+            break;
+
+            // emit the oldest batch once its worker is finished
+        ReadBatch *b = inflight.front();
+        {
+            std::unique_lock<std::mutex> lock(q.mtx);
+            q.done_cv.wait(lock, [&] { return b->done; });
+        }
+        out.write(b->out);
+        rejected += b->rejected;
+        below += b->below;
+        masked += b->masked;
+        inflight.pop_front();
+        idle.push_back(b);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(q.mtx);
+        q.closed = true;
+    }
+    q.todo_cv.notify_all();
+    for (auto &th : workers)
+        th.join();
+
+    out.flush();
+    fflush(stdout);
+
+    long grows = 0;
+    for (auto &a : arenas)
+        grows += a.grows();
+
+    double elapsed = tmr.elapsed();
+    cerr << "reads: " << nreads << "  bases: " << nbases << endl;
+    if (filter)
+        cerr << "prefilter (min score " << opt.min_score << "): passed " << nreads - rejected
+             << "  rejected " << rejected << "  aligned below min: " << below << endl;
+    if (mask && opt.mask_mode == "soft")
+        cerr << "hits dropped as mostly masked: " << masked << endl;
+    cerr << "arena buffer grows: " << grows << endl;
+    if (HugePages::used())
+        cerr << HugePages::stats() << endl;
+    if (cache)
+        cerr << cache->stats() << endl;
+    if (perf) {
+        perf->mark("read/write", 0);
+        perfReport(cerr, *perf);
+        PerfSample total;
+        for (int w = 0; w < opt.threads; w++) {
+            cerr << perfLine("worker " + std::to_string(w), arenas[w].perf) << endl;
+            total.add(arenas[w].perf);
+        }
+        if (opt.threads > 1)
+            cerr << perfLine("workers", total) << endl;
+    }
+    cerr << "** streaming, " << opt.threads << " worker(s) **" << endl;
+    cerr << "elapsed time: " << elapsed << " seconds." << endl;
+}
+
+/*
+ * extend mode: start from the reference and an empty query, then apply
+ * one update per input line ("t BASES" appends to the query, "s BASES"
+ * to the reference) and after each print
+ *   ref_len  query_len  score  ref_beg  ref_end  query_beg  query_end  cigar
+ * with only the score and ends, which cost nothing past the update:
+ * ref_beg, query_beg and cigar are '*'.  the traceback that fills them
+ * in is a refill of the best cell's window, so it runs only for an "a"
+ * line and once after the last update
+ */
+void extendReads(const Options &opt) {
+    Timer tmr;
+
+    IncrementalAligner inc;
+    std::vector<char> s = loadSeqFile(opt.files[0]);
+    inc.appendRef(s.data(), s.size());
+    cerr << "REFERENCE(S): " << opt.files[0] << " size: " << s.size() << endl;
+
+    InputFile inFile(opt.files[1]);
+    if (! inFile.ok()) {
+        cerr << "\nextendReads() error: cannot open " << opt.files[1] << ".\n";
+        exit(-1);
+    }
+    istream &in = inFile.in();
+
+    Arena arena;
+    BufWriter out;
+    tuple<int, int, int> traced(-1, 0, 0);     // best() as of arena.aln
+    auto report = [&](bool full) {
+        auto b = inc.best();
+        bool mapped = get<0>(b) > 0;
+        if (full && b != traced) {
+            inc.align(arena);
+            traced = b;
+        }
+        out.writeInt(inc.ref().size());
+        out.put('\t');
+        out.writeInt(inc.query().size());
+        out.put('\t');
+        out.writeInt(get<0>(b));
+        for (int k = 0; k < 2; k++) {
+            out.put('\t');
+            if (full)
+                out.writeInt(k ? arena.aln.t_beg : arena.aln.s_beg);
+            else
+                out.put('*');
+            out.put('\t');
+            out.writeInt(mapped ? (k ? get<2>(b) : get<1>(b)) : 0);
+        }
+        out.put('\t');
+        if (full)
+            out.writeCigar(arena.aln.cigar);
+        else
+            out.put('*');
+        out.put('\n');
+        out.flush();    // one result per update, as it happens
+    };
+
+    string line;
+    long updates = 0;
+    bool pending = false;       // updates since the last full line
+    while (getline(in, line)) {
+        if (line.empty())
+            continue;
+        if (line[0] == 'a' && line.find_first_not_of(" \t\r", 1) == string::npos) {
+            report(true);
+            pending = false;
+            continue;
+        }
+        string bases;
+        for (size_t k = 1; k < line.size(); k++)
+            if (! isspace((unsigned char) line[k]))
+                bases.push_back(line[k]);
+        if (line[0] == 't')
+            inc.appendQuery(bases.data(), bases.size());
+        else if (line[0] == 's')
+            inc.appendRef(bases.data(), bases.size());
+        else {
+            cerr << "\nextendReads() error: bad update: " << line << "\n";
+            exit(-1);
+        }
+        updates++;
+        report(false);
+        pending = true;
+    }
+    if (pending)
+        report(true);
+
+    double elapsed = tmr.elapsed();
+    cerr << "updates: " << updates << endl;
+    cerr << "** incremental **" << endl;
+    cerr << "elapsed time: " << elapsed << " seconds." << endl;
+}
+
+/*
+ * server mode wire format (host byte order; local socket only):
+ *   request: uint32 op, tag, strand (0 fwd, 1 rev, 2 both), length;
+ *            then length query bytes (none for stats and stop)
+ *   SERVE_ALIGN -> uint32 tag, then the "bin" record of writeResult()
+ *                  with an empty name
+ *   SERVE_STATS -> uint32 tag, length; then length bytes of text
+ *   SERVE_STOP  -> no reply; the server finishes queued work and exits
+ *   an unknown op or a length past SERVE_MAX_QUERY -> uint32 tag,
+ *                  SERVE_ERROR, length; then length bytes of text, and
+ *                  the server closes the connection
+ * with SERVE_PENDING queries queued, a connection's next align request
+ * waits for room, so a client that outpaces the workers is throttled
+ * rather than queued without bound
+ */
+#define SERVE_ALIGN 1
+#define SERVE_STATS 2
+#define SERVE_STOP 3
+#define SERVE_ERROR 0xffffffffu     // in an error reply, after the tag
+#define SERVE_BATCH 64          // queries per sweep of s
+#define SERVE_WAIT_US 200       // how long a worker waits for a fuller batch
+#define SERVE_SAMPLES 4096      // latencies kept for the stats percentiles
+#define SERVE_MAX_QUERY (1 << 20)   // longest query accepted, bytes
+#define SERVE_PENDING 4096      // queued queries before readers wait
+
+typedef std::chrono::steady_clock serve_clock;
+
+struct ServeConn {
+    int fd;
+    std::mutex wmtx;    // whole replies only
+
+    explicit ServeConn(int f) : fd(f) {}
+    ~ServeConn() { close(fd); }
+
+    void reply(const string &buf) {
+        std::lock_guard<std::mutex> lock(wmtx);
+        for (size_t off = 0; off < buf.size(); ) {
+            ssize_t k = send(fd, buf.data() + off, buf.size() - off, MSG_NOSIGNAL);
+            if (k < 0 && errno == EINTR)
+                continue;
+            if (k <= 0)
+                return;     // client went away (no SIGPIPE)
+            off += k;
+        }
+    }
+};
+
+const char *SERVE_STRANDS[] = { "fwd", "rev", "both" };
+
+struct ServeReq {
+    std::shared_ptr<ServeConn> conn;
+    uint32_t tag;
+    uint32_t strand;
+    uint64_t key;       // result cache
+    SeqRecord rec;
+    serve_clock::time_point start;
+};
+
+/*
+ * state shared by the server's connection threads and workers
+ */
+struct ServeState {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::condition_variable room;   // pending fell below SERVE_PENDING
+    std::deque<ServeReq> pending;
+    std::vector<string> spare;      // query buffers back from the workers
+    bool stopping;
+    int lfd;
+    ResultCache *cache;
+    uint64_t ref;                   // reference hash for cache keys
+
+    std::mutex smtx;                // stats below
+    std::vector<double> lat_us;     // ring of the last SERVE_SAMPLES
+    long requests;
+    long batches;
+
+    ServeState() : stopping(false), lfd(-1), cache(nullptr), ref(0), requests(0), batches(0) {}
+
+    void record(double us) {
+        std::lock_guard<std::mutex> lock(smtx);
+        if (lat_us.size() < SERVE_SAMPLES)
+            lat_us.push_back(us);
+        else
+            lat_us[requests % SERVE_SAMPLES] = us;
+        requests++;
+    }
+
+    string stats() {
+        std::lock_guard<std::mutex> lock(smtx);
+        std::vector<double> v(lat_us);
+        std::sort(v.begin(), v.end());
+        auto pct = [&](double p) { return v.empty() ? 0.0 : v[(size_t) (p * (v.size() - 1))]; };
+        return "requests " + std::to_string(requests) + " batches " + std::to_string(batches)
+             + " p50_us " + std::to_string((long) pct(0.50))
+             + " p99_us " + std::to_string((long) pct(0.99))
+             + (cache ? "  " + cache->stats() : "") + "\n";
+    }
+};
+
+/*
+ * align a micro-batch: a --strand both query is scored on its own in
+ * strandScores()' interleaved lanes, as alignRead() does; the rest, and
+ * any it declines, share one multi-segment sweep over s (both strands
+ * of a query are two segments).  then trace back each query's winner
+ * and reply on its connection
+ */
+void serveBatch(const std::vector<char> &s, std::vector<ServeReq> &batch,
+                ServeState &st, Arena &arena, string &out) {
+    auto finish = [&](ServeReq &req, const tuple<int, int, int> &tup, const char *q, bool rev) {
+        int n = req.rec.seq.size();
+        size_t cap = arena.aln.cigar.capacity();
+        alignWindow(s, SeqView(q, n), get<0>(tup), get<1>(tup), get<2>(tup), arena);
+        arena.aln.reverse = rev;
+        arena.noteGrow(cap, arena.aln.cigar.capacity());
+        if (st.cache)
+            st.cache->put(req.key, req.rec.seq.data(), n, arena.aln);
+
+        out.clear();
+        BufWriter w(out);
+        w.write((const char *) &req.tag, sizeof req.tag);
+        writeResult(w, "bin", "", req.rec, arena.aln);
+        w.flush();
+        req.conn->reply(out);
+
+        st.record(std::chrono::duration<double, std::micro>(serve_clock::now() - req.start).count());
+    };
+
+    int *segs = arena.get(arena.segs, batch.size());
+    for (size_t r = 0; r < batch.size(); r++) {
+        auto &req = batch[r];
+        int n = req.rec.seq.size();
+        segs[r] = -1;
+        if (req.strand != 2)
+            continue;
+        size_t qcap = arena.query.capacity();
+        arena.query.assign(req.rec.seq);
+        appendRevComp(arena.query, req.rec.seq);
+        arena.noteGrow(qcap, arena.query.capacity());
+        if (! strandScores(s.data(), s.size(), arena.query.data(), n, arena))
+            continue;
+        bool rev = get<0>(arena.best[1]) > get<0>(arena.best[0]);
+        segs[r] = -2;   // answered
+        finish(req, arena.best[rev], arena.query.data() + (rev ? n : 0), rev);
+    }
+
+    size_t qcap = arena.query.capacity();
+    arena.query.clear();
+    arena.ends.clear();
+    for (size_t r = 0; r < batch.size(); r++) {
+        auto &req = batch[r];
+        if (segs[r] == -2)
+            continue;
+        segs[r] = arena.ends.size();
+        if (req.strand != 1) {
+            arena.query += req.rec.seq;
+            arena.ends.push_back(arena.query.size());
+        }
+        if (req.strand != 0) {
+            appendRevComp(arena.query, req.rec.seq);
+            arena.ends.push_back(arena.query.size());
+        }
+    }
+    arena.noteGrow(qcap, arena.query.capacity());
+    if (! arena.ends.empty())
+        localScores(s, arena.query, arena);
+
+    for (size_t r = 0; r < batch.size(); r++) {
+        auto &req = batch[r];
+        int k = segs[r];
+        if (k < 0)
+            continue;
+        int n = req.rec.seq.size();
+        bool rev = req.strand == 1 ||
+                   (req.strand == 2 && get<0>(arena.best[k+1]) > get<0>(arena.best[k]));
+        if (rev && req.strand == 2)
+            k++;
+        finish(req, arena.best[k], arena.query.data() + arena.ends[k] - n, rev);
+    }
+
+    std::lock_guard<std::mutex> lock(st.smtx);
+    st.batches++;
+}
+
+/*
+ * server worker: take up to SERVE_BATCH queued queries, waiting up to
+ * SERVE_WAIT_US for more when fewer are in, until stopped and drained
+ */
+void serveWorker(const std::vector<char> &s, ServeState &st, Arena &arena) {
+    std::vector<ServeReq> batch;
+    string out;     // reply buffer, reused
+    for (;;) {
+        batch.clear();
+        {
+            std::unique_lock<std::mutex> lock(st.mtx);
+            st.cv.wait(lock, [&] { return ! st.pending.empty() || st.stopping; });
+            if (st.pending.empty())
+                return;
+            if (st.pending.size() < SERVE_BATCH)
+                st.cv.wait_for(lock, std::chrono::microseconds(SERVE_WAIT_US), [&] {
+                    return st.pending.size() >= SERVE_BATCH || st.stopping; });
+            while (! st.pending.empty() && batch.size() < SERVE_BATCH) {
+                batch.push_back(std::move(st.pending.front()));
+                st.pending.pop_front();
+            }
+        }
+        st.room.notify_all();
+        if (batch.empty())
+            continue;
+        serveBatch(s, batch, st, arena, out);
+
+            // hand the query buffers back for reuse by the readers
+        std::lock_guard<std::mutex> lock(st.mtx);
+        for (auto &req : batch)
+            if (st.spare.size() < SERVE_PENDING)
+                st.spare.push_back(std::move(req.rec.seq));
+    }
+}
+
+/*
+ * error reply (see SERVE_ERROR); the caller then drops the connection
+ */
+void serveError(ServeConn &conn, uint32_t tag, const string &text) {
+    uint32_t head[3] = { tag, SERVE_ERROR, (uint32_t) text.size() };
+    conn.reply(string((const char *) head, sizeof head) + text);
+}
+
+/*
+ * read requests off one client connection until it closes; cached
+ * results are answered right here, without queueing.  a query is read
+ * into a buffer the workers handed back, once they have handed any
+ */
+void serveRequests(std::shared_ptr<ServeConn> conn, ServeState &st) {
+    Alignment aln;
+    string out;
+    ServeReq req;
+    for (;;) {
+        uint32_t hdr[4];
+        size_t got = 0;
+        while (got < sizeof hdr) {
+            ssize_t k = read(conn->fd, (char *) hdr + got, sizeof hdr - got);
+            if (k <= 0)
+                return;
+            got += k;
+        }
+
+        if (req.rec.seq.capacity() < hdr[3]) {
+            std::lock_guard<std::mutex> lock(st.mtx);
+            if (! st.spare.empty()) {
+                req.rec.seq.swap(st.spare.back());
+                st.spare.pop_back();
+            }
+        }
+        req.start = serve_clock::now();
+        req.tag = hdr[1];
+        req.strand = std::min<uint32_t>(hdr[2], 2);
+        if (hdr[3] > SERVE_MAX_QUERY) {
+            serveError(*conn, req.tag, "query longer than " + std::to_string(SERVE_MAX_QUERY) + " bytes\n");
+            return;
+        }
+        req.rec.seq.resize(hdr[3]);
+        for (got = 0; got < hdr[3]; ) {
+            ssize_t k = read(conn->fd, &req.rec.seq[got], hdr[3] - got);
+            if (k <= 0)
+                return;
+            got += k;
+        }
+
+        if (hdr[0] == SERVE_ALIGN && st.cache) {
+            req.key = ResultCache::key(st.ref, ResultCache::mode("sw", SERVE_STRANDS[req.strand], false),
+                                       req.rec.seq.data(), req.rec.seq.size());
+            if (st.cache->get(req.key, req.rec.seq.data(), req.rec.seq.size(), aln)) {
+                out.clear();
+                BufWriter w(out);
+                w.write((const char *) &req.tag, sizeof req.tag);
+                writeResult(w, "bin", "", req.rec, aln);
+                w.flush();
+                conn->reply(out);
+                st.record(std::chrono::duration<double, std::micro>(serve_clock::now() - req.start).count());
+                continue;
+            }
+        }
+
+        if (hdr[0] == SERVE_ALIGN) {
+            req.conn = conn;
+            {
+                std::unique_lock<std::mutex> lock(st.mtx);
+                st.room.wait(lock, [&] { return st.pending.size() < SERVE_PENDING || st.stopping; });
+                if (st.stopping)
+                    return;
+                st.pending.push_back(std::move(req));
+            }
+            st.cv.notify_one();
+        } else if (hdr[0] == SERVE_STATS) {
+            string text = st.stats();
+            uint32_t head[2] = { req.tag, (uint32_t) text.size() };
+            conn->reply(string((const char *) head, sizeof head) + text);
+        } else if (hdr[0] == SERVE_STOP) {
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                st.stopping = true;
+            }
+            st.cv.notify_all();
+            st.room.notify_all();
+            shutdown(st.lfd, SHUT_RDWR);    // wakes accept()
+            return;
+        } else {
+            serveError(*conn, req.tag, "unknown op " + std::to_string(hdr[0]) + "\n");
+            return;
+        }
+    }
+}
+
+/*
+ * connection thread: serveRequests(), then flag done so the accept
+ * loop can join it.  the connection closes once its queued replies
+ * are out, with the last reference
+ */
+void serveConn(std::shared_ptr<ServeConn> conn, ServeState &st,
+               std::shared_ptr<std::atomic<bool>> done) {
+    serveRequests(std::move(conn), st);
+    *done = true;
+}
+
+/*
+ * server mode: load the reference once, listen on the unix socket
+ * opt.serve and answer alignment requests (see SERVE_ALIGN) with
+ * opt.threads resident workers, each with its own arena.  concurrent
+ * short queries are micro-batched into one multi-segment sweep of s
+ */
+void serveReads(const Options &opt) {
+    string refName;
+    std::vector<char> s = loadSeqFile(opt.files[0], &refName);
+    cerr << "REFERENCE(S): " << opt.files[0] << " size: " << s.size() << endl;
+    maskReference(s, opt);
+
+    ServeState st;
+    std::unique_ptr<ResultCache> cache;
+    if (opt.cache)
+        cache.reset(new ResultCache(opt.cache, opt.cache_dir));
+    st.cache = cache.get();
+    st.ref = hashBytes(s.data(), s.size(), 0);
+    st.lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    if (opt.serve.size() >= sizeof addr.sun_path) {
+        cerr << "\nserveReads() error: socket path too long.\n";
+        exit(-1);
+    }
+    strcpy(addr.sun_path, opt.serve.c_str());
+    unlink(addr.sun_path);
+    if (st.lfd < 0 || bind(st.lfd, (sockaddr *) &addr, sizeof addr) != 0 || listen(st.lfd, 64) != 0) {
+        cerr << "\nserveReads() error: cannot listen on " << opt.serve << ".\n";
+        exit(-1);
+    }
+    cerr << "listening on " << opt.serve << " with " << opt.threads << " worker(s)" << endl;
+
+    std::vector<Arena> arenas(opt.threads);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < opt.threads; w++)
+        workers.push_back(std::thread(serveWorker, std::cref(s), std::ref(st), std::ref(arenas[w])));
+
+        // connection threads hold st, so each is joined before returning:
+        // finished ones as new clients come in, the rest after a stop
+    struct ConnThread {
+        std::thread th;
+        std::weak_ptr<ServeConn> conn;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::list<ConnThread> conns;
+    for (;;) {
+        int fd = accept(st.lfd, nullptr, nullptr);
+        if (fd < 0) {
+            {
+                std::lock_guard<std::mutex> lock(st.mtx);
+                if (st.stopping)
+                    break;
+            }
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                usleep(10000);
+                continue;
+            }
+            cerr << "\nserveReads() error: accept failed: " << strerror(errno) << ".\n";
+            break;
+        }
+
+        for (auto it = conns.begin(); it != conns.end(); )
+            if (*it->done) {
+                it->th.join();
+                it = conns.erase(it);
+            } else
+                it++;
+        auto conn = std::make_shared<ServeConn>(fd);
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        conns.push_back(ConnThread{ std::thread(serveConn, conn, std::ref(st), done), conn, done });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(st.mtx);
+        st.stopping = true;
+    }
+    st.cv.notify_all();
+    for (auto &th : workers)
+        th.join();
+
+        // queued work is answered; wake clients still connected
+    for (auto &c : conns)
+        if (auto conn = c.conn.lock())
+            shutdown(conn->fd, SHUT_RDWR);
+    for (auto &c : conns)
+        c.th.join();
+    close(st.lfd);
+    unlink(addr.sun_path);
+    cerr << st.stats();
+}
+
+/*
+ * pair mode for --strand rev/both: one fused score-only sweep of s
+ * for the requested strands, then traceback of only the window the
+ * best hit can span (cols refer to the reverse complement on '-')
+ */
+void pairStrands(const std::vector<char> &s, const std::vector<char> &t,
+                 const string &strand, Timer &tmr) {
+    Arena arena;
+    alignRead(s, string(t.begin(), t.end()), strand, arena);
+    const Alignment &aln = arena.aln;
+
+    cout << "\n\nmax score, location:\n(" << aln.score << ", [" << aln.s_end << ", " << aln.t_end << "])\n";
+    cout << "strand: " << (aln.reverse ? '-' : '+') << endl;
+
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded, strand " << strand << " **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+    cout << "\ntraceback:" << endl;
+    printAlignment(aln);
+}
+
+/*
+ * anti-diagonal fill (pair mode --engine simd): every cell of diagonal
+ * d = i + j depends only on diagonals d-1 and d-2, so a diagonal is
+ * computed 8 int16 cells per SSE2 instruction.  scores live in three
+ * rolling diagonals indexed by row; directions (codes as in
+ * alignWindowBy()) are written as bytes in diagonal-major order, so
+ * both stay contiguous.  same scores, ties and traceback as the
+ * full-matrix fill
+ */
+class DiagonalFill {
+public:
+    DiagonalFill(const char *s, long m, const char *t, long n, int match = MATCH_BONUS,
+                 int mismatch = MATCH_BONUS, int gap = GAP_PENALTY)
+        : m_(m), n_(n), match_(match), mismatch_(mismatch), gap_(gap), off_(m_ + n_ + 2, 0) {
+        for (long d = 2; d <= m_ + n_; d++)
+            off_[d + 1] = off_[d] + (ihi(d) - ilo(d) + 1);
+        dir_.resize(off_[m_ + n_ + 1] + 16);
+
+            // s, and t reversed so a diagonal reads it forwards; both
+            // padded so the last vector of a diagonal stays in bounds
+        s_.assign(s, s + m);
+        s_.resize(m_ + 16, 0);
+        tr_.assign(std::reverse_iterator<const char *>(t + n), std::reverse_iterator<const char *>(t));
+        tr_.resize(n_ + 16, 0);
+    }
+
+        // whether every score fits an int16 lane
+    static bool fits(long m, long n, int match) {
+        return (long) match * std::min(m, n) <= std::numeric_limits<int16_t>::max();
+    }
+
+        // fill; returns (score, row, col) as maxScore() would
+    tuple<int, int, int> fill() {
+            // each diagonal starts on a cache line
+        long stride = (m_ + 16 + CACHE_LINE / 2 - 1) & ~(long) (CACHE_LINE / 2 - 1);
+        row_buffer<int16_t> buf(3 * stride, 0);
+        int16_t *H2 = buf.data();               // diagonal d-2
+        int16_t *H1 = H2 + stride;              // d-1
+        int16_t *H0 = H1 + stride;              // d
+        int best = 0;
+        long brow = m_;
+        long bcol = n_;
+
+        for (long d = 2; d <= m_ + n_; d++) {
+            long lo = ilo(d);
+            long hi = ihi(d);
+            unsigned char *dd = &dir_[off_[d]] - lo;
+            int mx = diagonal(H0, H1, H2, dd, lo, hi, d);
+            H0[hi + 1] = 0;     // column 0 when hi = d - 1
+
+                // rescan only a diagonal that may hold the best cell
+            if (mx > 0 && mx >= best)
+                for (long i = lo; i <= hi; i++) {
+                    int v = H0[i];
+                    if (v > best || (v == best && v > 0 && (i > brow || (i == brow && d - i > bcol)))) {
+                        best = v;
+                        brow = i;
+                        bcol = d - i;
+                    }
+                }
+
+            int16_t *tmp = H2;
+            H2 = H1;
+            H1 = H0;
+            H0 = tmp;
+        }
+        return make_tuple(best, (int) brow, (int) bcol);
+    }
+
+        // trace back from (row, col) through the stored directions
+    Alignment traceback(const tuple<int, int, int> &b) const {
+        Alignment aln;
+        aln.score = get<0>(b);
+        long row = get<1>(b);
+        long col = get<2>(b);
+        if (aln.score <= 0)
+            return aln;
+
+        aln.s_end = row;
+        aln.t_end = col;
+        while (row > 0 && col > 0) {
+            int d = dir_[off_[row + col] + row - ilo(row + col)];
+            if (d == 0)
+                break;
+            aln.s_beg = row;
+            aln.t_beg = col;
+            if (d == 1) {
+                pushCigarOp(aln.cigar, CIGAR_D);     // North: s only
+                row--;
+            } else if (d == 2) {
+                pushCigarOp(aln.cigar, CIGAR_M);
+                row--;
+                col--;
+            } else {
+                pushCigarOp(aln.cigar, CIGAR_I);     // West: t only
+                col--;
+            }
+        }
+        std::reverse(aln.cigar.begin(), aln.cigar.end());
+        return aln;
+    }
+
+    size_t dirBytes() const { return off_[m_ + n_ + 1]; }
+
+private:
+    long ilo(long d) const { return std::max(1L, d - n_); }
+    long ihi(long d) const { return std::min(m_, d - 1); }
+
+        // cells lo..hi of diagonal d into H0 and dd; returns their max
+    int diagonal(int16_t *H0, const int16_t *H1, const int16_t *H2, unsigned char *dd,
+                 long lo, long hi, long d) {
+        const char *sp = s_.data() - 1;         // sp[i] = s[i-1]
+        const char *tp = tr_.data() + n_ - d;   // tp[i] = t[d-i-1]
+        long i = lo;
+        int mx = 0;
+
+#ifdef __SSE2__
+        const __m128i gap = _mm_set1_epi16(gap_);
+        const __m128i mis = _mm_set1_epi16(-mismatch_);
+        const __m128i hit = _mm_set1_epi16(match_ + mismatch_);
+        const __m128i wild = _mm_set1_epi8('?');
+        const __m128i zero = _mm_setzero_si128();
+        __m128i vmx = zero;
+
+        for (; i + 8 <= hi + 1; i += 8) {
+            __m128i sv = _mm_loadl_epi64((const __m128i *) (sp + i));
+            __m128i tv = _mm_loadl_epi64((const __m128i *) (tp + i));
+            __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(sv, tv),
+                         _mm_or_si128(_mm_cmpeq_epi8(sv, wild), _mm_cmpeq_epi8(tv, wild)));
+            eq = _mm_unpacklo_epi8(eq, eq);
+            __m128i sim = _mm_add_epi16(mis, _mm_and_si128(eq, hit));
+
+                // N, then NW, then W on ties
+            __m128i v = _mm_sub_epi16(_mm_loadu_si128((const __m128i *) (H1 + i - 1)), gap);
+            __m128i code = _mm_set1_epi16(1);
+            __m128i nw = _mm_add_epi16(_mm_loadu_si128((const __m128i *) (H2 + i - 1)), sim);
+            __m128i gt = _mm_cmpgt_epi16(nw, v);
+            v = _mm_max_epi16(v, nw);
+            code = _mm_or_si128(_mm_andnot_si128(gt, code), _mm_and_si128(gt, _mm_set1_epi16(2)));
+            __m128i w = _mm_sub_epi16(_mm_loadu_si128((const __m128i *) (H1 + i)), gap);
+            gt = _mm_cmpgt_epi16(w, v);
+            v = _mm_max_epi16(v, w);
+            code = _mm_or_si128(_mm_andnot_si128(gt, code), _mm_and_si128(gt, _mm_set1_epi16(3)));
+            __m128i pos = _mm_cmpgt_epi16(v, zero);
+            v = _mm_and_si128(v, pos);
+            code = _mm_and_si128(code, pos);
+
+            _mm_storeu_si128((__m128i *) (H0 + i), v);
+            _mm_storel_epi64((__m128i *) (dd + i), _mm_packus_epi16(code, code));
+            vmx = _mm_max_epi16(vmx, v);
+        }
+
+        int16_t lanes[8];
+        _mm_storeu_si128((__m128i *) lanes, vmx);
+        for (int k = 0; k < 8; k++)
+            mx = std::max<int>(mx, lanes[k]);
+#endif
+
+        for (; i <= hi; i++) {
+            char sc = sp[i];
+            char tc = tp[i];
+            int sim = (sc == tc || sc == '?' || tc == '?') ? match_ : -mismatch_;
+            int v = H1[i-1] - gap_;
+            unsigned char code = 1;
+            if (H2[i-1] + sim > v) {
+                v = H2[i-1] + sim;
+                code = 2;
+            }
+            if (H1[i] - gap_ > v) {
+                v = H1[i] - gap_;
+                code = 3;
+            }
+            if (v <= 0) {
+                v = 0;
+                code = 0;
+            }
+            H0[i] = v;
+            dd[i] = code;
+            mx = std::max(mx, v);
+        }
+        return mx;
+    }
+
+    long m_;
+    long n_;
+    int match_;
+    int mismatch_;
+    int gap_;
+    std::vector<long> off_;             // first direction of diagonal d
+    row_buffer<unsigned char> dir_;     // huge pages once past HUGE_PAGE
+    std::vector<char> s_;
+    std::vector<char> tr_;
+};
+
+/*
+ * pair mode --engine simd: DiagonalFill, then its traceback
+ */
+void pairDiagonal(const std::vector<char> &s, const std::vector<char> &t, Timer &tmr,
+                  PerfCounters *perf = nullptr) {
+    DiagonalFill fill(s.data(), s.size(), t.data(), t.size());
+    auto tup = fill.fill();
+    if (perf)
+        perf->mark("fill", (long) s.size() * t.size());
+
+    cout << "\n\nmax score, location:\n(" << get<0>(tup) << ", [" << get<1>(tup) << ", "
+         << get<2>(tup) << "])\n";
+    cout << "diagonal-major directions: " << fill.dirBytes() << " bytes" << endl;
+
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded, anti-diagonal SIMD **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+    cout << "\ntraceback:" << endl;
+    printAlignment(fill.traceback(tup));
+    if (perf)
+        perf->mark("traceback", 0);
+    if (HugePages::used())
+        cout << "\n" << HugePages::stats() << endl;
+}
+
+/*
+ * pair mode for --scoring edit: the fewest edits placing t in s
+ */
+void pairEdit(const std::vector<char> &s, const std::vector<char> &t, const Options &opt,
+              Timer &tmr) {
+    Arena arena;
+    alignEdit(s, string(t.begin(), t.end()), opt.strand, opt.engine, arena);
+    const Alignment &aln = arena.aln;
+
+    cout << "\n\nmin edit distance, location:\n(" << aln.score << ", [" << aln.s_end << ", "
+         << aln.t_end << "])" << (aln.reverse ? "  strand: -" : "") << endl;
+
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded, " << (opt.engine == "scalar" ? "scalar" : "bit-vector")
+         << " edit search **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+    cout << "\ntraceback:" << endl;
+    printAlignment(aln);
+}
+
+/*
+ * pair mode for --translate: s is read as nucleotide FASTA/raw and t as
+ * a protein; reports the best of the six frames in nucleotides of s
+ */
+void pairTranslated(const Options &opt, Timer &tmr) {
+    std::vector<char> s = loadSeqFile(opt.files[0]);
+    std::vector<char> t = loadSeqFile(opt.files[1]);
+    cout << "\nSEQUENCE(S): " << opt.files[0] << " size: " << s.size();
+    cout << "\n  PROTEIN(T): " << opt.files[1] << " size: " << t.size();
+
+    Arena arena;
+    alignTranslated(s, string(t.begin(), t.end()), arena);
+    const Alignment &aln = arena.aln;
+
+    cout << "\n\nmax score: " << aln.score << "  frame: " << showpos << aln.frame << noshowpos << endl;
+    cout << "nucleotides: [" << aln.s_beg << ", " << aln.s_end << "]  residues: ["
+         << aln.t_beg << ", " << aln.t_end << "]" << endl;
+
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded, six-frame translated **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+    cout << "\ncigar (residues): ";
+    BufWriter out;
+    out.writeCigar(aln.cigar);
+    out.put('\n');
+}
+
+/*
+ * pair mode full-matrix fill, traceback and report with Cell-wide
+ * similarity scores.  prefetch > 0 prefetches the cells that far ahead
+ * in fill order, into the next row at a row's end.  bounded: no score
+ * can exceed Cell (MATCH_BONUS * min(|s|, |t|) fits), so a max score at
+ * the Cell maximum is exact rather than saturated
+ * returns: [bool] false if the cells saturated (nothing printed but a note)
+ */
+template <typename Cell>
+bool pairFill(const std::vector<char> &s, const std::vector<char> &t, Timer &tmr,
+              Alignment &aln, SeqLoader *loader = nullptr, PerfCounters *perf = nullptr,
+              int prefetch = 0, bool bounded = false) {
+    long cells = (long) s.size() * t.size();
+        // create similarity and traceback() direction matrices; only the
+        // similarity border (row, col = 0) is read before being written
+    sim_matrix<Cell> sim_mat(s.size() + 1, t.size() + 1);
+    dir_matrix dir_mat(s.size() + 1, t.size() + 1);
+    const Cell *sim_cells = &sim_mat(0, 0);
+    const unsigned char *dir_cells = &dir_mat(0, 0);
+    long ncols = sim_mat.size2();
+    long ncells = sim_mat.size1() * ncols;
+
+    for (int j = 0; j <= (int) t.size(); j++)
+        sim_mat(0, j) = 0;
+    for (int i = 1; i <= (int) s.size(); i++)
+        sim_mat(i, 0) = 0;
+
+        // main task:
+        // compute & update S-W scores (sim_mat); also directions (dir_mat),
+        // each row as soon as its char of s is loaded
+    for (int i = 1; i <= (int) s.size(); i++) {
+        if (loader)
+            loader->waitFor(i);
+        for (int j = 1; j <= (int) t.size(); j++) {
+                // once per cache line of each matrix's cells
+            long k = i * ncols + j + prefetch;
+            if (prefetch && k < ncells) {
+                if ((j & (CACHE_LINE / sizeof(Cell) - 1)) == 0)
+                    __builtin_prefetch(sim_cells + k, 1);
+                if ((j & (CACHE_LINE - 1)) == 0)
+                    __builtin_prefetch(dir_cells + k, 1);
+            }
+            SmithWaterman(sim_mat, dir_mat, s, t, i, j);
+        }
+    }
+    if (perf)
+        perf->mark("fill", cells);
+
+    // cout << endl;
+    // printSimMatrix(sim_mat);
+    // cout << endl;
+    // printDirMatrix(dir_mat);
+
+        // retrieve max score; at the cell maximum it may have saturated
+    auto tup = maxScore(sim_mat);
+    if (perf)
+        perf->mark("max score", cells);
+    if (sizeof(Cell) < sizeof(int32_t) && ! bounded && get<0>(tup) == std::numeric_limits<Cell>::max()) {
+        cout << "\n\nint" << 8 * sizeof(Cell) << " cells saturated; re-running wider.";
+        if (perf)
+            perf->relabel(2, " (int" + std::to_string(8 * sizeof(Cell)) + ", saturated)");
+        return false;
+    }
+
+    cout << "\n\nmax score, location:\n(" << get<0>(tup) << ", [" << get<1>(tup) << ", " << get<2>(tup) << "])\n";
+    cout << "similarity matrix dims: (" << sim_mat.size1() << "x" << sim_mat.size2() << ")"
+         << "  cells: int" << 8 * sizeof(Cell) << endl;
+
+        // stop the timer
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+        // print the traceback path
+    auto maxop = make_tuple(get<1>(tup), get<2>(tup));
+    cout << "\ntraceback:" << endl;
+    aln = traceback(sim_mat, dir_mat, maxop);
+    printAlignment(aln);
+    if (perf)
+        perf->mark("traceback", 0);
+    if (HugePages::used())
+        cout << "\n" << HugePages::stats() << endl;
+    return true;
+}
+
+/*
+ * out-of-core traceback store: 2-bit directions (see alignWindowBy())
+ * for an m x n fill in a file-backed mapping, laid out in TILE x TILE
+ * tiles of one page each in fill order (a stripe of TILE rows, tiles
+ * left to right), so the fill writes the file sequentially
+ */
+#define TILE 128
+#define TILE_BYTES (TILE * TILE / 4)
+
+class TileStore {
+public:
+    TileStore(const string &path, long m, long n, bool resume)
+        : m_(m), n_(n), tcols_((n + TILE - 1) / TILE), map_(nullptr) {
+        long stripes = (m + TILE - 1) / TILE;
+        len_ = TILE_BYTES * (1 + stripes * tcols_);    // header page first
+
+        int fd = open(path.c_str(), resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            fail("cannot open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (resume && st.st_size != len_))
+            fail(path + " does not match these inputs");
+        if (! resume && ftruncate(fd, len_) != 0)
+            fail("cannot size " + path);
+
+        map_ = (unsigned char *) mmap(nullptr, len_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map_ == MAP_FAILED)
+            fail("cannot map " + path);
+        madvise(map_, len_, MADV_SEQUENTIAL);
+    }
+
+    ~TileStore() { munmap(map_, len_); }
+
+        // tile (stripe, tc), TILE_BYTES long
+    unsigned char *tile(long stripe, long tc) {
+        return map_ + TILE_BYTES * (1 + stripe * tcols_ + tc);
+    }
+
+        // direction of cell (row, col), both 1-based
+    int dir(long row, long col) const {
+        long r = row - 1;
+        long c = col - 1;
+        const unsigned char *p = map_ + TILE_BYTES * (1 + r / TILE * tcols_ + c / TILE);
+        int k = r % TILE * TILE + c % TILE;
+        return p[k >> 2] >> 2 * (k & 3) & 3;
+    }
+
+        // write back every tile before stripe end (MS_SYNC waits)
+    void sync(long end, int flags) {
+        long upto = TILE_BYTES * (1 + end * tcols_);
+        msync(map_, upto, flags);
+    }
+
+    long tileCols() const { return tcols_; }
+
+private:
+    static void fail(const string &msg) {
+        cerr << "\nTileStore() error: " << msg << ".\n";
+        exit(-1);
+    }
+
+    long m_;
+    long n_;
+    long tcols_;
+    long len_;
+    unsigned char *map_;
+};
+
+/*
+ * checkpoint of the fill frontier: the next stripe, the best cell so
+ * far and the scores of the last finished row, tied to its inputs by
+ * a hash
+ */
+struct Checkpoint {
+    uint64_t hash;
+    long stripe;
+    long best_score;
+    long best_row;
+    long best_col;
+    std::vector<int> H;
+};
+
+uint64_t fnv1a(const std::vector<char> &v, uint64_t h = 14695981039346656037ULL) {
+    for (char ch : v)
+        h = (h ^ (unsigned char) ch) * 1099511628211ULL;
+    return h;
+}
+
+/*
+ * write ck next to the tile file: to a temporary first, renamed over
+ * the old one once complete, so a crash leaves the previous checkpoint
+ */
+void saveCheckpoint(const string &path, const Checkpoint &ck) {
+    string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (! f) {
+        cerr << "\nsaveCheckpoint() error: cannot write " << tmp << ".\n";
+        exit(-1);
+    }
+    long hdr[4] = { ck.stripe, ck.best_score, ck.best_row, ck.best_col };
+    bool ok = fwrite("ALNSWC01", 1, 8, f) == 8
+           && fwrite(&ck.hash, sizeof ck.hash, 1, f) == 1
+           && fwrite(hdr, sizeof hdr, 1, f) == 1
+           && fwrite(ck.H.data(), sizeof(int), ck.H.size(), f) == ck.H.size();
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    fclose(f);
+    if (! ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        cerr << "\nsaveCheckpoint() error: cannot write " << path << ".\n";
+        exit(-1);
+    }
+}
+
+/*
+ * read the checkpoint at path into ck (H sized by the caller)
+ * returns: [bool] false if missing or for other inputs
+ */
+bool loadCheckpoint(const string &path, Checkpoint &ck) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if (! f)
+        return false;
+    char magic[8];
+    uint64_t hash;
+    long hdr[4];
+    bool ok = fread(magic, 1, 8, f) == 8 && memcmp(magic, "ALNSWC01", 8) == 0
+           && fread(&hash, sizeof hash, 1, f) == 1 && hash == ck.hash
+           && fread(hdr, sizeof hdr, 1, f) == 1
+           && fread(ck.H.data(), sizeof(int), ck.H.size(), f) == ck.H.size();
+    fclose(f);
+    if (ok) {
+        ck.stripe = hdr[0];
+        ck.best_score = hdr[1];
+        ck.best_row = hdr[2];
+        ck.best_col = hdr[3];
+    }
+    return ok;
+}
+
+/*
+ * pair mode --ooc: fill with a rolling score row, keeping only 2-bit
+ * directions in a TileStore at opt.ooc, one stripe of TILE rows at a
+ * time; the frontier is checkpointed to opt.ooc + ".ckpt" every
+ * opt.checkpoint seconds, and --resume continues from there.  same
+ * scores, tie rules and traceback as the in-memory fill
+ */
+void pairOutOfCore(const std::vector<char> &s, const std::vector<char> &t,
+                   const Options &opt, Timer &tmr) {
+    long m = s.size();
+    long n = t.size();
+    long stripes = (m + TILE - 1) / TILE;
+    string ckpath = opt.ooc + ".ckpt";
+
+    Checkpoint ck;
+    ck.hash = fnv1a(t, fnv1a(s)) ^ (uint64_t) m * 31 ^ (uint64_t) n;
+    ck.H.assign(n + 1, 0);
+    ck.stripe = 0;
+    ck.best_score = 0;
+    ck.best_row = m;
+    ck.best_col = n;
+
+    bool resume = opt.resume && loadCheckpoint(ckpath, ck);
+    if (opt.resume && ! resume)
+        cout << "\n\nno usable checkpoint in " << ckpath << "; starting over.";
+    if (resume)
+        cout << "\n\nresuming at row " << ck.stripe * TILE << " of " << m << ".";
+
+    TileStore store(opt.ooc, m, n, resume);
+    int *H = ck.H.data();
+    std::vector<int> left(TILE);
+    Timer since;
+
+    for (long st = ck.stripe; st < stripes; st++) {
+        long r0 = st * TILE;
+        long r1 = std::min(m, r0 + TILE);
+        std::fill(left.begin(), left.end(), 0);
+        int corner = 0;
+
+        for (long tc = 0; tc < store.tileCols(); tc++) {
+            long c0 = tc * TILE;
+            long c1 = std::min(n, c0 + TILE);
+            unsigned char *tile = store.tile(st, tc);
+            int next_corner = H[c1];
+            int up_left = corner;
+
+            for (long i = r0 + 1; i <= r1; i++) {
+                int k = i - r0 - 1;
+                int west = left[k];
+                int diag = up_left;
+                up_left = west;
+                char sc = s[i-1];
+                unsigned char *drow = tile + k * (TILE / 4);
+
+                for (long j = c0 + 1; j <= c1; j++) {
+                    char tc_ = t[j-1];
+                    int north = H[j];
+                    int sim = (sc == tc_ || sc == '?' || tc_ == '?') ? MATCH_BONUS : -MATCH_BONUS;
+
+                        // N, then NW, then W on ties, as in SmithWaterman()
+                    int v = north - GAP_PENALTY;
+                    int d = 1;
+                    if (diag + sim > v) {
+                        v = diag + sim;
+                        d = 2;
+                    }
+                    if (west - GAP_PENALTY > v) {
+                        v = west - GAP_PENALTY;
+                        d = 3;
+                    }
+                    if (v <= 0) {
+                        v = 0;
+                        d = 0;
+                    }
+
+                    diag = north;
+                    H[j] = v;
+                    west = v;
+                    int jj = j - c0 - 1;
+                    drow[jj >> 2] = (drow[jj >> 2] & ~(3 << 2 * (jj & 3))) | d << 2 * (jj & 3);
+
+                        // largest score, then largest row, then column
+                    if (v > 0 && (v > ck.best_score || (v == ck.best_score &&
+                        (i > ck.best_row || (i == ck.best_row && j > ck.best_col))))) {
+                        ck.best_score = v;
+                        ck.best_row = i;
+                        ck.best_col = j;
+                    }
+                }
+                left[k] = west;
+            }
+            corner = next_corner;
+        }
+
+        store.sync(st + 1, MS_ASYNC);
+        if (opt.checkpoint >= 0 && since.elapsed() >= opt.checkpoint && st + 1 < stripes) {
+            store.sync(st + 1, MS_SYNC);
+            ck.stripe = st + 1;
+            saveCheckpoint(ckpath, ck);
+            since.reset();
+        }
+    }
+
+    cout << "\n\nmax score, location:\n(" << ck.best_score << ", [" << ck.best_row << ", "
+         << ck.best_col << "])\n";
+    cout << "tile store: " << opt.ooc << " (" << stripes * store.tileCols() << " tiles of "
+         << TILE << "x" << TILE << ")" << endl;
+
+    double elapsed = tmr.elapsed();
+    cout << "\n** single-threaded, out-of-core **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+        // trace back through the stored directions
+    Alignment aln;
+    long row = ck.best_row;
+    long col = ck.best_col;
+    aln.score = ck.best_score;
+    if (aln.score > 0) {
+        aln.s_end = row;
+        aln.t_end = col;
+        for (int d; (d = store.dir(row, col)) != 0; ) {
+            aln.s_beg = row;
+            aln.t_beg = col;
+            if (d == 1) {
+                pushCigarOp(aln.cigar, CIGAR_D);     // North: s only
+                row--;
+            } else if (d == 2) {
+                pushCigarOp(aln.cigar, CIGAR_M);
+                row--;
+                col--;
+            } else {
+                pushCigarOp(aln.cigar, CIGAR_I);     // West: t only
+                col--;
+            }
+            if (row == 0 || col == 0)
+                break;
+        }
+        std::reverse(aln.cigar.begin(), aln.cigar.end());
+    }
+    cout << "\ntraceback:" << endl;
+    printAlignment(aln);
+
+    remove(ckpath.c_str());
+}
+
+/*
+ * one end of a byte link between two processes of the partitioned
+ * engine (see pairPartitioned()); send and recv block until the whole
+ * buffer is through
+ */
+class Channel {
+public:
+    virtual ~Channel() {}
+    virtual void send(const void *buf, size_t len) = 0;
+    virtual void recv(void *buf, size_t len) = 0;
+};
+
+/*
+ * Channel over a connected socket (unix or tcp)
+ */
+class FdChannel : public Channel {
+public:
+    explicit FdChannel(int fd) : fd_(fd) {}
+    ~FdChannel() { close(fd_); }
+
+    void send(const void *buf, size_t len) override {
+        const char *p = (const char *) buf;
+        while (len > 0) {
+            ssize_t k = write(fd_, p, len);
+            if (k <= 0)
+                fail("write");
+            p += k;
+            len -= k;
+        }
+    }
+
+    void recv(void *buf, size_t len) override {
+        char *p = (char *) buf;
+        while (len > 0) {
+            ssize_t k = read(fd_, p, len);
+            if (k <= 0)
+                fail("read");
+            p += k;
+            len -= k;
+        }
+    }
+
+private:
+    static void fail(const char *what) {
+        cerr << "\nFdChannel() error: " << what << " failed.\n";
+        exit(-1);
+    }
+
+    int fd_;
+};
+
+/*
+ * single-producer, single-consumer byte ring in memory shared across
+ * fork(); a full or empty ring spins, then yields
+ */
+#define RING_BYTES (1 << 16)
 
-    return fileContents;
-}
+struct ShmRing {
+    std::atomic<uint64_t> head;     // bytes written
+    std::atomic<uint64_t> tail;     // bytes read
+    char data[RING_BYTES];
+};
+
+class ShmChannel : public Channel {
+public:
+    ShmChannel(ShmRing *out, ShmRing *in) : out_(out), in_(in) {}
+
+    void send(const void *buf, size_t len) override {
+        const char *p = (const char *) buf;
+        uint64_t head = out_->head.load(std::memory_order_relaxed);
+        while (len > 0) {
+            uint64_t room;
+            for (int spin = 0; (room = RING_BYTES - (head - out_->tail.load(std::memory_order_acquire))) == 0; spin++)
+                if (spin > 64)
+                    sched_yield();
+            size_t k = std::min<uint64_t>(std::min<uint64_t>(len, room), RING_BYTES - head % RING_BYTES);
+            memcpy(out_->data + head % RING_BYTES, p, k);
+            head += k;
+            out_->head.store(head, std::memory_order_release);
+            p += k;
+            len -= k;
+        }
+    }
+
+    void recv(void *buf, size_t len) override {
+        char *p = (char *) buf;
+        uint64_t tail = in_->tail.load(std::memory_order_relaxed);
+        while (len > 0) {
+            uint64_t avail;
+            for (int spin = 0; (avail = in_->head.load(std::memory_order_acquire) - tail) == 0; spin++)
+                if (spin > 64)
+                    sched_yield();
+            size_t k = std::min<uint64_t>(std::min<uint64_t>(len, avail), RING_BYTES - tail % RING_BYTES);
+            memcpy(p, in_->data + tail % RING_BYTES, k);
+            tail += k;
+            in_->tail.store(tail, std::memory_order_release);
+            p += k;
+            len -= k;
+        }
+    }
+
+private:
+    ShmRing *out_;
+    ShmRing *in_;
+};
 
 /*
- * print a nucleotide sequence
+ * a connected pair of Channel ends over the named transport ("unix",
+ * "tcp" on the loopback, or "shm") for forked workers on this machine;
+ * made before fork(), each process then keeps only the ends it talks
+ * through.  workers on other machines connect through --peers instead
  */
-void printSeq(const std::vector<char> &seq) {
-    cout << "\ncontents = ";
-    for (auto &ch : seq)
-        cout << ch;
-    cout << endl;
+struct Link {
+    std::unique_ptr<Channel> a;
+    std::unique_ptr<Channel> b;
+};
+
+Link makeLink(const string &transport) {
+    Link link;
+    int fds[2];
+
+    if (transport == "unix") {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            cerr << "\nmakeLink() error: socketpair failed.\n";
+            exit(-1);
+        }
+    } else if (transport == "tcp") {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t alen = sizeof addr;
+        int lfd = socket(AF_INET, SOCK_STREAM, 0);
+        fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+        if (lfd < 0 || fds[0] < 0
+            || bind(lfd, (sockaddr *) &addr, sizeof addr) != 0 || listen(lfd, 1) != 0
+            || getsockname(lfd, (sockaddr *) &addr, &alen) != 0
+            || connect(fds[0], (sockaddr *) &addr, sizeof addr) != 0
+            || (fds[1] = accept(lfd, nullptr, nullptr)) < 0) {
+            cerr << "\nmakeLink() error: tcp loopback connection failed.\n";
+            exit(-1);
+        }
+        close(lfd);
+        int one = 1;
+        setsockopt(fds[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        setsockopt(fds[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    } else {
+        void *p = mmap(nullptr, 2 * sizeof(ShmRing), PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            cerr << "\nmakeLink() error: cannot map shared ring.\n";
+            exit(-1);
+        }
+        ShmRing *rings = new (p) ShmRing[2];
+        link.a.reset(new ShmChannel(&rings[0], &rings[1]));
+        link.b.reset(new ShmChannel(&rings[1], &rings[0]));
+        return link;
+    }
+
+    link.a.reset(new FdChannel(fds[0]));
+    link.b.reset(new FdChannel(fds[1]));
+    return link;
 }
 
 /*
- * print a uBLAS matrix<int> (similarity)
- */ 
-void printSimMatrix(const matrix<int> &mat) {
-    for (int i = 0; i < mat.size1(); i++) {
-        for (int j = 0; j < mat.size2(); j++) {
-                cout << mat(i, j) << " ";
-        }
-        cout << endl;
+ * --peers: tcp endpoints "host:port" of the partitioned engine's
+ * workers, one per stripe, so stripes can run on other machines
+ */
+#define PEER_WAIT 30        // seconds to keep retrying a peer not yet up
+
+sockaddr_in peerAddr(const string &peer) {
+    size_t colon = peer.rfind(':');
+    addrinfo hints, *res = nullptr;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (colon == string::npos
+        || getaddrinfo(peer.substr(0, colon).c_str(), peer.substr(colon + 1).c_str(), &hints, &res) != 0) {
+        cerr << "\npeerAddr() error: cannot resolve " << peer << ".\n";
+        exit(-1);
     }
+    sockaddr_in addr = *(sockaddr_in *) res->ai_addr;
+    freeaddrinfo(res);
+    return addr;
 }
 
 /*
- * print a uBLAS matrix<tup<int, int>> (tuple)
+ * connect to peer, retrying for PEER_WAIT seconds while it starts
+ * returns: [int] connected socket
  */
-void printTupMatrix(const matrix<tuple<int, int>> &mat) {
-    for (int i = 0; i < mat.size1(); i++) {
-        for (int j = 0; j < mat.size2(); j++) {
-            auto tup = mat(i, j);
-            cout << "[" << get<0>(tup) << ", " << get<1>(tup) << "] ";
+int peerConnect(const string &peer) {
+    sockaddr_in addr = peerAddr(peer);
+    for (int tries = 0; ; tries++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *) &addr, sizeof addr) == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            return fd;
         }
-        cout << endl;
+        if (fd >= 0)
+            close(fd);
+        if (tries >= 10 * PEER_WAIT) {
+            cerr << "\npeerConnect() error: cannot connect to " << peer << ".\n";
+            exit(-1);
+        }
+        usleep(100000);
     }
 }
 
 /*
- * retrieve S-W score for a North cell, minus GAP_PENALTY
- * returns: [int]
+ * first message on every peer connection: who is calling, and the
+ * problem it was started on, which both ends must agree about
  */
-int North(const matrix<int> &smat, int row, int col) { 
-    if (row == 0 || col == 0) {
-        cerr << "\nNorth() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1);
-    }
+struct HelloMsg {
+    long role;          // 0: coordinator, 1: left neighbor
+    long m;
+    long n;
+    long procs;
+    uint64_t inputs;    // hashBytes() of s, then of t on top
+};
 
-    // North-adjusted row
-    int adjRow = row - 1;
+/*
+ * partitioned engine messages: a worker's best cell after the fill,
+ * and one leg of the traceback through a worker's stripe
+ */
+#define STRIPE_ROWS 256
 
-    return smat(adjRow, col) - GAP_PENALTY;
-}
+struct BestMsg {
+    long score;
+    long row;
+    long col;
+};
+
+struct TraceMsg {
+    long row;           // where the leg left off (or stopped)
+    long col;
+    long beg_row;       // last cell on the path
+    long beg_col;
+    long nops;          // packed CIGAR ops that follow
+    long done;          // hit a zero cell; no further legs
+};
 
 /*
- * retrieve S-W score for a West cell, minus GAP_PENALTY
- * returns: [int]
+ * partitioned worker: fill columns (c0, c1] of the full matrix with
+ * the left boundary column streamed from the left neighbor in blocks of
+ * STRIPE_ROWS rows and its own last column streamed on to the right,
+ * keep direction bytes for its stripe, report its best cell and then
+ * serve traceback legs until the coordinator sends row < 0
  */
-int West(const matrix<int> &smat, int row, int col) {
-    if (row == 0 || col == 0) {
-        cerr << "\nWest() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1); 
+void partitionWorker(const std::vector<char> &s, const std::vector<char> &t,
+                     long c0, long c1, Channel *left, Channel *right, Channel &coord) {
+    long m = s.size();
+    long w = c1 - c0;
+    std::vector<int> H(w + 1, 0);
+    std::vector<unsigned char> dir(m * w);
+    std::vector<int> lcol(STRIPE_ROWS, 0);
+    std::vector<int> rcol(STRIPE_ROWS);
+    BestMsg best = { 0, m, (long) t.size() };
+    int up_left = 0;    // left boundary, previous row
+
+    for (long r0 = 0; r0 < m; r0 += STRIPE_ROWS) {
+        long rows = std::min<long>(STRIPE_ROWS, m - r0);
+        if (left)
+            left->recv(lcol.data(), rows * sizeof(int));
+
+        for (long k = 0; k < rows; k++) {
+            long i = r0 + k + 1;
+            int west = lcol[k];
+            int diag = up_left;
+            up_left = west;
+            char sc = s[i-1];
+            unsigned char *drow = &dir[(i - 1) * w];
+
+            for (long jj = 1; jj <= w; jj++) {
+                char tc = t[c0 + jj - 1];
+                int north = H[jj];
+                int sim = (sc == tc || sc == '?' || tc == '?') ? MATCH_BONUS : -MATCH_BONUS;
+
+                    // N, then NW, then W on ties, as in SmithWaterman()
+                int v = north - GAP_PENALTY;
+                unsigned char d = 1;
+                if (diag + sim > v) {
+                    v = diag + sim;
+                    d = 2;
+                }
+                if (west - GAP_PENALTY > v) {
+                    v = west - GAP_PENALTY;
+                    d = 3;
+                }
+                if (v <= 0) {
+                    v = 0;
+                    d = 0;
+                }
+
+                diag = north;
+                H[jj] = v;
+                west = v;
+                drow[jj-1] = d;
+
+                long j = c0 + jj;
+                if (v > 0 && (v > best.score || (v == best.score &&
+                    (i > best.row || (i == best.row && j > best.col))))) {
+                    best.score = v;
+                    best.row = i;
+                    best.col = j;
+                }
+            }
+            rcol[k] = west;
+        }
+
+        if (right)
+            right->send(rcol.data(), rows * sizeof(int));
     }
 
-    // West-adjusted col
-    int adjCol = col - 1;
+    coord.send(&best, sizeof best);
 
-    return smat(row, adjCol) - GAP_PENALTY;
+        // traceback legs
+    std::vector<uint32_t> ops;
+    for (;;) {
+        long at[2];
+        coord.recv(at, sizeof at);
+        if (at[0] < 0)
+            return;
+
+        TraceMsg msg = { at[0], at[1], at[0], at[1], 0, 0 };
+        ops.clear();
+        long row = at[0];
+        long col = at[1];
+        for (;;) {
+            int d = dir[(row - 1) * w + (col - c0 - 1)];
+            if (d == 0) {
+                msg.done = 1;
+                break;
+            }
+            msg.beg_row = row;
+            msg.beg_col = col;
+            if (d == 1) {
+                pushCigarOp(ops, CIGAR_D);   // North: s only
+                row--;
+            } else if (d == 2) {
+                pushCigarOp(ops, CIGAR_M);
+                row--;
+                col--;
+            } else {
+                pushCigarOp(ops, CIGAR_I);   // West: t only
+                col--;
+            }
+            if (row == 0 || col == 0) {
+                msg.done = 1;
+                break;
+            }
+            if (col == c0)
+                break;      // on into the left neighbor's stripe
+        }
+        msg.row = row;
+        msg.col = col;
+        msg.nops = ops.size();
+        coord.send(&msg, sizeof msg);
+        coord.send(ops.data(), ops.size() * sizeof(uint32_t));
+    }
 }
 
 /*
- * determine if two nucleotides match, see MATCH_BONUS
- * returns: [int]
+ * stripe boundaries of the partitioned engine: stripe k owns columns
+ * (cut[k], cut[k+1]]
+ * returns: [std::vector<long>]
  */
-int similarity(const std::vector<char> &s, 
-               const std::vector<char> &t, 
-               int row, int col) {
-    
-    if (row == 0 || col == 0) {
-        cerr << "\nsimilarity() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1); 
-    }
+std::vector<long> stripeCuts(long n, int procs) {
+    std::vector<long> cut(procs + 1);
+    for (int k = 0; k <= procs; k++)
+        cut[k] = n * k / procs;
 
-        // s and t are 0-indexed
-    if ( (s[row-1] == t[col-1]) || s[row-1] == '?' || t[col-1] == '?' )
-        return MATCH_BONUS;
-    else
-        return MATCH_BONUS * -1;
+    return cut;
 }
 
 /*
- * return a Smith-Waterman score for a NorthWest cell
- * returns: [int]
+ * pair mode --procs N: split the columns of the full matrix into N
+ * stripes, each filled by a worker process; boundary columns flow left
+ * to right through a pipelined wavefront over the chosen transport.
+ * workers are forked here, or with --peers run as align --worker K on
+ * any machine (see partitionPeer()) and are reached over tcp.  this
+ * process coordinates: it picks the best of the workers' best cells
+ * and stitches the traceback from legs walked by the owner of each
+ * stripe.  same scores, ties and traceback as the single-process fill
  */
-int NorthWest(const matrix<int> &smat,
-              const std::vector<char> &s,
-              const std::vector<char> &t,
-              int row, int col) {
+void pairPartitioned(const std::vector<char> &s, const std::vector<char> &t,
+                     const Options &opt, Timer &tmr) {
+    long n = t.size();
+    int procs = std::max<long>(1, std::min<long>(opt.procs, n));
+    std::vector<long> cut = stripeCuts(n, procs);
 
-    if (row == 0 || col == 0) {
-        cerr << "\nNorthWest() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1); 
+    std::vector<Link> coord(procs);
+    std::vector<Link> bound(procs);     // bound[k]: k-1 -> k
+    std::vector<pid_t> pids;
+    if (! opt.peers.empty()) {
+        if (procs != (int) opt.peers.size()) {
+            cerr << "\npairPartitioned() error: " << opt.peers.size() << " peers for "
+                 << procs << " stripes.\n";
+            exit(-1);
+        }
+        for (int k = 0; k < procs; k++) {
+            coord[k].a.reset(new FdChannel(peerConnect(opt.peers[k])));
+            HelloMsg hello = { 0, (long) s.size(), n, procs,
+                               hashBytes(t.data(), t.size(), hashBytes(s.data(), s.size(), 0)) };
+            coord[k].a->send(&hello, sizeof hello);
+        }
+    } else {
+        for (int k = 0; k < procs; k++) {
+            coord[k] = makeLink(opt.transport);
+            if (k > 0)
+                bound[k] = makeLink(opt.transport);
+        }
+
+        fflush(stdout);
+        for (int k = 0; k < procs; k++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                cerr << "\npairPartitioned() error: fork failed.\n";
+                exit(-1);
+            }
+            if (pid == 0) {
+                    // close every link end this worker does not talk through
+                for (int j = 0; j < procs; j++) {
+                    coord[j].a.reset();
+                    if (j != k)
+                        coord[j].b.reset();
+                    if (j != k + 1)
+                        bound[j].a.reset();
+                    if (j != k)
+                        bound[j].b.reset();
+                }
+                partitionWorker(s, t, cut[k], cut[k+1], bound[k].b.get(),
+                                k + 1 < procs ? bound[k+1].a.get() : nullptr, *coord[k].b);
+                _exit(0);
+            }
+            pids.push_back(pid);
+        }
+
+            // and the coordinator keeps only its own ends
+        for (int k = 0; k < procs; k++) {
+            coord[k].b.reset();
+            bound[k].a.reset();
+            bound[k].b.reset();
+        }
     }
 
-    // North-West adjustment
-    int adjRow = row - 1;
-    int adjCol = col - 1;
+        // best of the workers' best cells, same tie rule
+    BestMsg best = { 0, (long) s.size(), n };
+    for (int k = 0; k < procs; k++) {
+        BestMsg b;
+        coord[k].a->recv(&b, sizeof b);
+        if (b.score > 0 && (b.score > best.score || (b.score == best.score &&
+            (b.row > best.row || (b.row == best.row && b.col > best.col)))))
+            best = b;
+    }
 
-    return smat(adjRow, adjCol) + similarity(s, t, row, col);
+    cout << "\n\nmax score, location:\n(" << best.score << ", [" << best.row << ", "
+         << best.col << "])\n";
+    double elapsed = tmr.elapsed();
+    cout << "\n** " << procs << " process(es), " << opt.transport << " transport **" << endl;
+    cout << "elapsed time: " << elapsed << " seconds." << endl;
+
+        // stitch the traceback, leg by leg, right to left
+    Alignment aln;
+    aln.score = best.score;
+    if (best.score > 0) {
+        aln.s_end = best.row;
+        aln.t_end = best.col;
+        long at[2] = { best.row, best.col };
+        std::vector<uint32_t> ops;
+        for (;;) {
+            int k = std::upper_bound(cut.begin(), cut.end(), at[1] - 1) - cut.begin() - 1;
+            coord[k].a->send(at, sizeof at);
+            TraceMsg msg;
+            coord[k].a->recv(&msg, sizeof msg);
+            ops.resize(msg.nops);
+            coord[k].a->recv(ops.data(), ops.size() * sizeof(uint32_t));
+
+            for (uint32_t op : ops)
+                if (! aln.cigar.empty() && (aln.cigar.back() & 0xf) == (op & 0xf))
+                    aln.cigar.back() += op & ~0xfu;
+                else
+                    aln.cigar.push_back(op);
+            if (msg.nops) {
+                aln.s_beg = msg.beg_row;
+                aln.t_beg = msg.beg_col;
+            }
+            if (msg.done)
+                break;
+            at[0] = msg.row;
+            at[1] = msg.col;
+        }
+        std::reverse(aln.cigar.begin(), aln.cigar.end());
+    }
+
+    long stop[2] = { -1, -1 };
+    for (int k = 0; k < procs; k++)
+        coord[k].a->send(stop, sizeof stop);
+    for (pid_t pid : pids)
+        waitpid(pid, nullptr, 0);
+
+    cout << "\ntraceback:" << endl;
+    printAlignment(aln);
 }
 
 /*
- * compute the source cell for a Smith-Waterman score
- * return [tuple<int, int>]
+ * align --worker K --peers LIST: stripe K of a --peers run, started on
+ * any machine with the same inputs.  listens on LIST[K], connects on
+ * to stripe K+1, and takes the coordinator and stripe K-1 in whichever
+ * order they arrive
  */
-tuple<int, int> source(int idx, int row, int col) {
-    if (row == 0 || col == 0) {
-        cerr << "\nsource() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1); 
+void partitionPeer(const std::vector<char> &s, const std::vector<char> &t, const Options &opt) {
+    long n = t.size();
+    int procs = std::max<long>(1, std::min<long>(opt.procs, n));
+    int k = opt.worker;
+    if (procs != (int) opt.peers.size() || k >= procs) {
+        cerr << "\npartitionPeer() error: no stripe " << k << " among " << procs << ".\n";
+        exit(-1);
     }
+    std::vector<long> cut = stripeCuts(n, procs);
 
-    switch (idx) {
-        case 0:     // North
-            row = row - 1;
-            break;
-        case 1:     // NW
-            row = row - 1;
-            col = col - 1;
-            break;
-        case 2:     // West
-            col = col - 1;
-            break;
-        default:
-            cerr << "\nsource() error: invalid index.\n";
-            break;
+    sockaddr_in addr = peerAddr(opt.peers[k]);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    int one = 1;
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (lfd < 0 || setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one) != 0
+        || bind(lfd, (sockaddr *) &addr, sizeof addr) != 0 || listen(lfd, 4) != 0) {
+        cerr << "\npartitionPeer() error: cannot listen on " << opt.peers[k] << ".\n";
+        exit(-1);
     }
 
-    return make_tuple(row, col);
+    HelloMsg hello = { 1, (long) s.size(), n, procs,
+                       hashBytes(t.data(), t.size(), hashBytes(s.data(), s.size(), 0)) };
+    std::unique_ptr<Channel> right;
+    if (k + 1 < procs) {
+        right.reset(new FdChannel(peerConnect(opt.peers[k + 1])));
+        right->send(&hello, sizeof hello);
+    }
+
+    std::unique_ptr<Channel> coord, left;
+    while (! coord || (k > 0 && ! left)) {
+        int fd = accept(lfd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            cerr << "\npartitionPeer() error: accept failed.\n";
+            exit(-1);
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+        std::unique_ptr<Channel> ch(new FdChannel(fd));
+        HelloMsg from;
+        ch->recv(&from, sizeof from);
+        if (from.m != hello.m || from.n != hello.n || from.procs != hello.procs
+            || from.inputs != hello.inputs) {
+            cerr << "\npartitionPeer() error: peer was started on other inputs.\n";
+            exit(-1);
+        }
+        (from.role == 0 ? coord : left) = std::move(ch);
+    }
+    close(lfd);
+
+    partitionWorker(s, t, cut[k], cut[k+1], left.get(), right.get(), *coord);
+    cout << "\nstripe " << k << " of " << procs << ": cols (" << cut[k] << ", " << cut[k+1]
+         << "] done." << endl;
 }
 
 /*
- * update Smith-Waterman score for each sim. matrix (smat) cell;
- * also update source for each score in tuple matrix (tmat)
+ * main program
  */
-void SmithWaterman(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
-                   const std::vector<char> &s,
-                   const std::vector<char> &t,
-                   int row, int col) {
+#ifdef ALIGNSW_LIBRARY
 
-    if (row == 0 || col == 0) {
-        cerr << "\nSmithWaterman() error: nucleotide coordinates cannot be zero.\n";
-        exit(-1); 
-    }
-   
-        // set up vector<int> of neighbor scores
-    std::vector<int> scores;
-    scores.push_back(North(smat, row, col));
-    scores.push_back(NorthWest(smat, s, t, row, col));
-    scores.push_back(West(smat, row, col));
+/*
+ * libalignsw.so: the C interface of alignsw.h.  each calling thread
+ * keeps its own Arena, so repeated calls reuse their scratch
+ */
+namespace {
+thread_local Arena lib_arena;
+}
 
-        // get largest neighbor score
-    auto top_score = max_element(scores.begin(), scores.end());
-    
-    if (*top_score < 0)
-        *top_score = 0;
+extern "C" alignsw_scoring alignsw_default_scoring(void) {
+    alignsw_scoring sc = { MATCH_BONUS, MATCH_BONUS, GAP_PENALTY };
+    return sc;
+}
 
-        // update similarity matrix
-    smat(row, col) = *top_score;
-        
-        // get top score index; update tuple matrix with source() 
-    int  top_index = distance(scores.begin(), top_score);
-    tmat(row, col) = source(top_index, row, col);
+extern "C" int alignsw_version(void) {
+    return ALIGNSW_VERSION;
 }
 
-/*
- * find the largest, rightmost, lowermost score in a 
- * uBLAS S-W similarity matrix and its [x, y] coordinates
- * returns: [tuple<int, int, int>]
- */
-tuple<int, int, int> maxScore(const matrix<int> &smat) {
-    int s_sz = smat.size1() - 1;
-    int t_sz = smat.size2() - 1;
-    
-    int cur_max = 0;
-    int row = s_sz;
-    int col = t_sz;
+extern "C" const char *alignsw_strerror(int code) {
+    switch (code) {
+        case ALIGNSW_OK: return "success";
+        case ALIGNSW_E_ARG: return "invalid argument or engine";
+        case ALIGNSW_E_SCORING: return "scoring parameters out of range";
+        case ALIGNSW_E_RANGE: return "sequences too long for the engine's score width";
+        case ALIGNSW_E_CIGAR: return "CIGAR buffer too small";
+        case ALIGNSW_E_MEMORY: return "out of memory";
+    }
+    return "unknown error";
+}
 
-    for (int i = s_sz; i >= 1; i--)
-        for (int j = t_sz; j >= 1; j--) {
-            if (smat(i, j) > cur_max) {
-                cur_max = smat(i, j);
-                row = i;
-                col = j;
+extern "C" int alignsw_align(const char *s, size_t s_len, const char *t, size_t t_len,
+                             const alignsw_scoring *scoring, int engine,
+                             alignsw_result *result, char *cigar, size_t cigar_cap) {
+    if ((! s && s_len) || (! t && t_len) || ! result || (! cigar && cigar_cap) ||
+        s_len > (size_t) std::numeric_limits<int>::max() ||
+        t_len > (size_t) std::numeric_limits<int>::max())
+        return ALIGNSW_E_ARG;
+    alignsw_scoring sc = scoring ? *scoring : alignsw_default_scoring();
+    if (sc.match < 1 || sc.match > 1000 || sc.mismatch < 0 || sc.mismatch > 1000 ||
+        sc.gap < 0 || sc.gap > 1000)
+        return ALIGNSW_E_SCORING;
+
+    Alignment aln;
+    try {
+        SeqView sv(s, s_len);
+        SeqView tv(t, t_len);
+        switch (engine) {
+            case ALIGNSW_ENGINE_AUTO:
+            case ALIGNSW_ENGINE_SIMD: {
+                    // too long for int16: the default scoring can still
+                    // take the int32 score sweep and windowed traceback
+                bool dflt = sc.match == MATCH_BONUS && sc.mismatch == MATCH_BONUS &&
+                            sc.gap == GAP_PENALTY;
+                if (engine == ALIGNSW_ENGINE_AUTO && dflt &&
+                    ! DiagonalFill::fits(s_len, t_len, sc.match)) {
+                    auto tup = localScore(sv, tv, lib_arena);
+                    alignWindow(sv, tv, get<0>(tup), get<1>(tup), get<2>(tup), lib_arena);
+                    aln = lib_arena.aln;
+                    break;
+                }
+                if (! DiagonalFill::fits(s_len, t_len, sc.match))
+                    return ALIGNSW_E_RANGE;
+                DiagonalFill fill(s, s_len, t, t_len, sc.match, sc.mismatch, sc.gap);
+                aln = fill.traceback(fill.fill());
+                break;
+            }
+            case ALIGNSW_ENGINE_EDIT:
+            case ALIGNSW_ENGINE_EDIT_SCALAR: {
+                EditHit hit = engine == ALIGNSW_ENGINE_EDIT ? editSearchBits(sv, tv, lib_arena)
+                                                            : editSearchScalar(sv, tv, lib_arena);
+                editTraceback(sv, tv, hit, lib_arena);
+                aln = lib_arena.aln;
+                break;
             }
+            default:
+                return ALIGNSW_E_ARG;
         }
+    } catch (const std::bad_alloc &) {
+        return ALIGNSW_E_MEMORY;
+    }
 
-    return make_tuple(cur_max, row, col);
+    result->score = aln.score;
+    result->s_beg = aln.s_beg;
+    result->s_end = aln.s_end;
+    result->t_beg = aln.t_beg;
+    result->t_end = aln.t_end;
+
+    string text;
+    {
+        BufWriter out(text);
+        out.writeCigar(aln.cigar);
+    }
+    result->cigar_len = text.size();
+    if (text.size() + 1 > cigar_cap)
+        return ALIGNSW_E_CIGAR;
+    memcpy(cigar, text.c_str(), text.size() + 1);
+    return ALIGNSW_OK;
 }
 
-/*
- * traceback the path from [0, 0] to the max score
- * prints: [vector of cell coordinates]
- */
-void traceback(const matrix<tuple<int, int>> &tmat, const tuple<int, int> &p) {
-    std::vector<tuple<int, int>> route;
-    route.push_back(p);
+#else
+
+int main(int argc, char* argv[]) {
+    Options opt = parseArgs(argc, argv);
+    HugePages::setMode(opt.hugepages);
 
-    auto cell = tmat(get<0>(p), get<1>(p));
-    while (cell != make_tuple(0, 0)) {
-       route.push_back(cell);
-       cell = tmat(get<0>(cell), get<1>(cell)); 
+    if (opt.stream) {
+        streamReads(opt);
+        return 0;
     }
 
-    std::reverse(route.begin(), route.end());
-    for (auto it=route.begin(); it!= route.end(); it++)
-        cout << "[" << get<0>(*it) << ", " << get<1>(*it) << "] ";
-    cout << endl;
-}
+    if (! opt.serve.empty()) {
+        serveReads(opt);
+        return 0;
+    }
 
-/*
- * main program
- */
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        cerr << "usage: align sequence_file unknown_file\n";
-        exit(-1);
+    if (opt.extend) {
+        extendReads(opt);
+        return 0;
     }
 
         // start the timer
     Timer tmr;
 
+    if (opt.translate) {
+        pairTranslated(opt, tmr);
+        return 0;
+    }
+
         // command-line args
-    string seqFilNam = argv[1];
-    string unkFilNam = argv[2];
+    string seqFilNam = opt.files[0];
+    string unkFilNam = opt.files[1];
 
-        // import sequences
-    std::vector<char> s = importSeqFile(seqFilNam);
-    s.shrink_to_fit();
-    s.pop_back();
+        // counters for this thread; s loads on the loader's own thread
+    std::unique_ptr<PerfCounters> perf;
+    if (opt.perf)
+        perf.reset(new PerfCounters);
+
+        // import sequences; s keeps loading behind the fill
+    SeqLoader loader(seqFilNam);
+    const std::vector<char> &s = loader.seq();
     cout << "\nSEQUENCE(S): " << seqFilNam << " size: " << s.size();
     // printSeq(s);
 
@@ -304,43 +5491,102 @@ int main(int argc, char* argv[]) {
     t.pop_back();
     cout << "\n UNKNOWN(T): " << unkFilNam << " size: " << t.size();
     // printSeq(t);
+    if (perf)
+        perf->mark("load t", 0);
 
-        // create and zero-out similarity matrix
-    matrix<int> sim_mat(s.size() + 1, t.size() + 1);
-    sim_mat.clear();
+        // every mode but the plain fill needs all of s first
+    bool plain = opt.min_score == 0 && opt.strand == "fwd" && opt.ooc.empty() && ! opt.procs
+              && ! opt.cache && opt.scoring == "sw" && opt.engine != "simd";
+    if (! plain)
+        loader.join();
 
-        // create and zero-out traceback() tuple matrix
-    matrix<tuple<int, int>> tup_mat(s.size() + 1, t.size() + 1);
-    tup_mat.clear();
+    row_buffer<unsigned char> lim;
+    if (opt.min_score > 0 &&
+        ! QgramFilter(s).pass(t.data(), t.size(), opt.strand, opt.min_score, lim)) {
+        cout << "\n\nprefilter: no alignment can reach min score " << opt.min_score
+             << "; skipped." << endl;
+        cout << "elapsed time: " << tmr.elapsed() << " seconds." << endl;
+        return 0;
+    }
 
-        // mark sim. matrix cells as not ready (except row, col = 0) 
-    for (int i = 1; i <= s.size(); i++)
-        for (int j = 1; j <= t.size(); j++)
-            sim_mat(i, j) = -999;
+    if (opt.scoring == "edit") {
+        pairEdit(s, t, opt, tmr);
+        return 0;
+    }
 
-        // main task:
-        // compute & update S-W scores (sim_mat); also source tuples (tup_mat)
-    for (int i = 1; i <= s.size(); i++)
-        for (int j = 1; j <= t.size(); j++)
-            SmithWaterman(sim_mat, tup_mat, s, t, i, j);
+    if (opt.strand != "fwd") {
+        pairStrands(s, t, opt.strand, tmr);
+        return 0;
+    }
 
-    // cout << endl;
-    // printSimMatrix(sim_mat);
-    // cout << endl;
-    // printTupMatrix(tup_mat);
+    if (! opt.ooc.empty()) {
+        pairOutOfCore(s, t, opt, tmr);
+        return 0;
+    }
 
-        // retrieve max score and output its location
-    auto tup = maxScore(sim_mat);
-    cout << "\n\nmax score, location:\n(" << get<0>(tup) << ", [" << get<1>(tup) << ", " << get<2>(tup) << "])\n";
-    cout << "similarity matrix dims: (" << sim_mat.size1() << "x" << sim_mat.size2() << ")" << endl;
+    if (opt.worker >= 0) {
+        partitionPeer(s, t, opt);
+        return 0;
+    }
 
-        // stop the timer
-    double elapsed = tmr.elapsed();
-    cout << "\n** single-threaded **" << endl;
-    cout << "elapsed time: " << elapsed << " seconds." << endl;
+    if (opt.procs) {
+        pairPartitioned(s, t, opt, tmr);
+        return 0;
+    }
 
-        // print the traceback path
-    auto maxop = make_tuple(get<1>(tup), get<2>(tup));
-    cout << "\ntraceback:" << endl;
-    traceback(tup_mat, maxop);
-}
\ No newline at end of file
+        // int16 lanes: scores up to MATCH_BONUS * min(|s|, |t|) must fit
+    if (opt.engine == "simd" && ! opt.cache && DiagonalFill::fits(s.size(), t.size(), MATCH_BONUS)) {
+        pairDiagonal(s, t, tmr, perf.get());
+        if (perf)
+            perfReport(cout, *perf);
+        return 0;
+    }
+
+        // narrowest provably safe cell width: scores never exceed
+        // MATCH_BONUS * min(|s|, |t|).  past int16 try int16 anyway,
+        // since local scores are usually small, and widen on saturation
+    long bound = (long) MATCH_BONUS * std::min(s.size(), t.size());
+    int width = opt.width;
+    if (width == 0)
+        width = bound <= std::numeric_limits<int8_t>::max() ? 8 : 16;
+
+        // a cached result skips the fill; pair mode matches --strand fwd
+    std::unique_ptr<ResultCache> cache;
+    uint64_t key = 0;
+    Alignment aln;
+    if (opt.cache) {
+        cache.reset(new ResultCache(opt.cache, opt.cache_dir));
+        key = ResultCache::key(hashBytes(s.data(), s.size(), 0), ResultCache::mode(opt.scoring, "fwd", false),
+                              t.data(), t.size());
+        if (cache->get(key, t.data(), t.size(), aln)) {
+            bool mapped = aln.score > 0;
+            cout << "\n\nmax score, location (cached):\n(" << aln.score << ", ["
+                 << (mapped ? aln.s_end : (long) s.size()) << ", "
+                 << (mapped ? aln.t_end : (long) t.size()) << "])\n";
+            cout << "elapsed time: " << tmr.elapsed() << " seconds." << endl;
+            cout << "\ntraceback:" << endl;
+            printAlignment(aln);
+            cout << "\n" << cache->stats() << endl;
+            return 0;
+        }
+    }
+
+    bool done = false;
+    if (width == 8)
+        done = pairFill<int8_t>(s, t, tmr, aln, &loader, perf.get(), opt.prefetch,
+                                bound <= std::numeric_limits<int8_t>::max());
+    if (! done && width <= 16)
+        done = pairFill<int16_t>(s, t, tmr, aln, &loader, perf.get(), opt.prefetch,
+                                 bound <= std::numeric_limits<int16_t>::max());
+    if (! done)
+        pairFill<int32_t>(s, t, tmr, aln, &loader, perf.get(), opt.prefetch);
+    if (perf)
+        perfReport(cout, *perf);
+
+    if (cache) {
+        cache->put(key, t.data(), t.size(), aln);
+        cout << "\n" << cache->stats() << endl;
+    }
+}
+
+#endif
@@ -126,6 +126,59 @@ function backtrack(mat)
 end
 
 
+# libalignsw.so (make lib): the C++ engines through alignsw.h
+const libalignsw = joinpath(dirname(@__FILE__), "libalignsw.so")
+
+const ALIGNSW_ENGINE_AUTO = 0
+const ALIGNSW_ENGINE_SIMD = 1
+const ALIGNSW_ENGINE_EDIT = 2
+const ALIGNSW_E_CIGAR = -4
+
+struct AlignswResult
+    score::Cint
+    s_beg::Cint
+    s_end::Cint
+    t_beg::Cint
+    t_end::Cint
+    cigar_len::Csize_t
+end
+
+# drops exactly the last byte (the newline), as the C++ front end does
+function importSeqBytes(fn::String)
+    seqdata = read(fn)
+
+    if !isempty(seqdata)
+        pop!(seqdata)
+    end
+
+    return seqdata
+end
+
+# sequences are passed in place; default scoring when scoring is C_NULL.
+# a CIGAR longer than the first guess is fetched again at the size the
+# library reports in cigar_len
+function alignLib(s::Vector{UInt8}, t::Vector{UInt8}, engine=ALIGNSW_ENGINE_AUTO)
+    res = Ref{AlignswResult}()
+    cigar = Vector{UInt8}(length(s) + length(t) + 1)
+
+    alignInto(buf) = ccall((:alignsw_align, libalignsw), Cint,
+                           (Ptr{UInt8}, Csize_t, Ptr{UInt8}, Csize_t, Ptr{Void}, Cint,
+                            Ref{AlignswResult}, Ptr{UInt8}, Csize_t),
+                           s, length(s), t, length(t), C_NULL, engine, res, buf, length(buf))
+    rc = alignInto(cigar)
+    if rc == ALIGNSW_E_CIGAR
+        cigar = Vector{UInt8}(res[].cigar_len + 1)
+        rc = alignInto(cigar)
+    end
+    if rc != 0
+        msg = unsafe_string(ccall((:alignsw_strerror, libalignsw), Cstring, (Cint,), rc))
+        error("alignsw_align: ", msg)
+    end
+
+    r = res[]
+    return (r.score, [r.s_end, r.t_end], String(cigar[1:r.cigar_len]))
+end
+
 
 # seqFilNam = "ex1_seq.txt"
 # unkFilNam = "ex1_unk.txt"
@@ -145,12 +198,6 @@ pop!(t)
 sim_mat = zeros(Matrix{Int}(length(s)+1,
                             length(t)+1))
 
-for j in 2:size(sim_mat, 2)
-    for i in 2:size(sim_mat, 1)
-        sim_mat[i, j] = -999
-    end
-end
-
 #display(sim_mat)
 
 tup_mat = Matrix{Tuple{Int, Int}}(length(s)+1,
@@ -170,3 +217,7 @@ end
 
 # display(sim_mat)
 println(backtrack(sim_mat))
+
+if isfile(libalignsw)
+    println(alignLib(importSeqBytes(seqFilNam), importSeqBytes(unkFilNam)))
+end
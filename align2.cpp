@@ -12,14 +12,23 @@
 
 
 #include <iostream>
+#include <string>
 #include <fstream>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
 #include <chrono>
 #include <utility>
 #include <algorithm>
+#include <set>
+#include <cstring>
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/io.hpp>
 
@@ -54,6 +63,183 @@ private:
     std::chrono::time_point<clock_> beg_;
 };
 
+/*
+ * allocator that leaves element construction to whoever first writes
+ * it, so matrix pages are first-touched (and NUMA-placed) by the stripe
+ * threads of firstTouchInit() instead of by main()
+ */
+template <class T>
+struct first_touch_allocator : std::allocator<T> {
+    template <class U> struct rebind { typedef first_touch_allocator<U> other; };
+
+    first_touch_allocator() {}
+    template <class U> first_touch_allocator(const first_touch_allocator<U> &) {}
+
+    template <class U, class... Args> void construct(U *, Args &&...) {}
+};
+
+typedef matrix<tuple<int, int>, row_major,
+               unbounded_array<tuple<int, int>, first_touch_allocator<tuple<int, int>>>> tup_matrix;
+
+/*
+ * column stripes: stripe k owns columns [k*n/NSTRIPES + 1, (k+1)*n/NSTRIPES]
+ * of every row (the same quarters the cascade splits rows into), and is
+ * placed on the k-th contiguous group of CPUs ordered by NUMA node
+ */
+#define NSTRIPES 4
+
+bool pin_threads = false;                   // --pin
+std::vector<std::vector<int>> stripe_cpus;  // CPU group per stripe
+
+std::mutex placement_mutex;
+std::set<int> placement_cpus[NSTRIPES];     // where stripe threads were placed
+std::set<int> placement_nodes[NSTRIPES];
+
+/*
+ * NUMA node of a CPU, from sysfs (0 if unknown)
+ * returns: [int]
+ */
+int cpuNode(int cpu) {
+    string path = "/sys/devices/system/cpu/cpu" + to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    int node = 0;
+    if (dir) {
+        while (struct dirent *ent = readdir(dir))
+            if (strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4]))
+                node = atoi(ent->d_name + 4);
+        closedir(dir);
+    }
+
+    return node;
+}
+
+/*
+ * split the CPUs this process may run on into NSTRIPES node-ordered groups
+ */
+void initStripeCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+
+    std::vector<pair<int, int>> cpus;   // (node, cpu)
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &set))
+            cpus.push_back(make_pair(cpuNode(c), c));
+    std::sort(cpus.begin(), cpus.end());
+
+    int n = cpus.size();
+    stripe_cpus.assign(NSTRIPES, std::vector<int>());
+    for (int k = 0; k < NSTRIPES; k++) {
+        for (int c = k * n / NSTRIPES; c < (k + 1) * n / NSTRIPES; c++)
+            stripe_cpus[k].push_back(cpus[c].second);
+        if (stripe_cpus[k].empty())
+            stripe_cpus[k].push_back(cpus[k % n].second);
+    }
+}
+
+/*
+ * stripe owning a column
+ * returns: [int]
+ */
+int stripeOf(int col, int n) {
+    for (int k = NSTRIPES - 1; k > 0; k--)
+        if (k * n / NSTRIPES + 1 <= col)
+            return k;
+
+    return 0;
+}
+
+/*
+ * called at the start of stripe work: pin the calling thread to its
+ * stripe's CPU group (with --pin) and record where it runs
+ */
+void placeThread(int stripe) {
+    if (pin_threads) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : stripe_cpus[stripe])
+            CPU_SET(c, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    unsigned cpu = 0, node = 0;
+    syscall(SYS_getcpu, &cpu, &node, nullptr);
+
+    placement_mutex.lock();
+        placement_cpus[stripe].insert(cpu);
+        placement_nodes[stripe].insert(node);
+    placement_mutex.unlock();
+}
+
+/*
+ * first-touch, from the calling thread, every page of mat's storage
+ * whose first element lies in stripe's columns (column 0 counts as
+ * stripe 0's).  when a row is narrower than a page, a page holds cells
+ * of every stripe and can only live on one node: pages then spread
+ * over the stripes in proportion to their columns, rather than all
+ * landing on one node.  a zero byte is harmless: nothing reads a cell
+ * before it is written
+ */
+template <class M>
+void touchPages(M &mat, int stripe) {
+    char *base = (char *) &mat.data()[0];
+    size_t elem = sizeof(typename M::value_type);
+    size_t bytes = mat.size1() * mat.size2() * elem;
+    size_t page = sysconf(_SC_PAGESIZE);
+    int n = mat.size2() - 1;
+
+        // the partial page before the first boundary is already mapped
+    for (size_t off = (page - (uintptr_t) base % page) % page; off < bytes; off += page) {
+        int col = (off / elem) % mat.size2();
+        if (stripeOf(std::max(col, 1), n) == stripe)
+            base[off] = 0;
+    }
+}
+
+/*
+ * place a stripe's share of both matrices' pages from a thread placed
+ * on that stripe
+ */
+void touchStripe(matrix<int> &smat, tup_matrix &tmat, int stripe) {
+    placeThread(stripe);
+    touchPages(smat, stripe);
+    touchPages(tmat, stripe);
+}
+
+/*
+ * place matrix pages stripe-parallel, then zero the similarity border
+ * (row, col = 0); its pages are placed by then, so main() may write it
+ */
+void firstTouchInit(matrix<int> &smat, tup_matrix &tmat) {
+    std::thread th[NSTRIPES];
+    for (int k = 0; k < NSTRIPES; k++)
+        th[k] = std::thread(touchStripe, std::ref(smat), std::ref(tmat), k);
+    for (int k = 0; k < NSTRIPES; k++)
+        th[k].join();
+
+    for (int j = 0; j < (int) smat.size2(); j++)
+        smat(0, j) = 0;
+    for (int i = 1; i < (int) smat.size1(); i++)
+        smat(i, 0) = 0;
+}
+
+/*
+ * print the column range, CPUs and NUMA nodes each stripe ran on
+ */
+void printPlacement(int n) {
+    cout << "thread placement (" << (pin_threads ? "pinned" : "unpinned") << "):" << endl;
+    for (int k = 0; k < NSTRIPES; k++) {
+        cout << "  stripe " << k << " cols [" << k * n / NSTRIPES + 1 << ", "
+             << (k + 1) * n / NSTRIPES << "]  cpus";
+        for (int c : placement_cpus[k])
+            cout << " " << c;
+        cout << "  nodes";
+        for (int nd : placement_nodes[k])
+            cout << " " << nd;
+        cout << endl;
+    }
+}
+
 /* 
  * import a nucleotide sequence file
  * returns: [vector<char>]
@@ -91,7 +277,7 @@ void printSimMatrix(const matrix<int> &mat) {
 /*
  * print a uBLAS matrix<tup<int, int>> (tuple)
  */
-void printTupMatrix(const matrix<tuple<int, int>> &mat) {
+void printTupMatrix(const tup_matrix &mat) {
     for (int i = 0; i < mat.size1(); i++) {
         for (int j = 0; j < mat.size2(); j++) {
             auto tup = mat(i, j);
@@ -208,7 +394,7 @@ tuple<int, int> source(int idx, int row, int col) {
  * also update source for each score in tuple matrix (tmat)
  * threads: use mutex to lock global readyqueue
  */
-void SmithWaterman(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
+void SmithWaterman(matrix<int> &smat, tup_matrix &tmat,
                    const std::vector<char> &s,
                    const std::vector<char> &t,
                    int row, int col) {
@@ -235,7 +421,8 @@ void SmithWaterman(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
         
         // get top score index; update tuple matrix with source() 
     int  top_index = distance(scores.begin(), top_score);
-    tmat(row, col) = source(top_index, row, col);
+        // construct in place: first_touch_allocator left the storage raw
+    new (&tmat(row, col)) tuple<int, int>(source(top_index, row, col));
 
     rq_mutex.lock();
             // push neighbors onto ready queue
@@ -278,45 +465,125 @@ tuple<int, int, int> maxScore(const matrix<int> &smat) {
 }
 
 /*
- * wrap SmithWaterman() in a thread-join. 
- */ 
-void threadedSW(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
-                const std::vector<char> &s,
-                const std::vector<char> &t,
-                int row, int col) {
-
-    std::thread th(SmithWaterman, std::ref(smat), std::ref(tmat),
-                 std::ref(s), std::ref(t), row, col);
-    th.join();
-}
-
-/*
- *
+ * one long-lived thread per column stripe, placed on its CPU group once.
+ * run() hands a cell to its stripe's thread and waits for it, so cells
+ * still run one at a time in readyqueue order
  */
-void traceback(const matrix<tuple<int, int>> &tmat, const tuple<int, int> &p) {
-    std::vector<tuple<int, int>> route;
-    route.push_back(p);
+class StripeWorkers {
+public:
+    StripeWorkers(matrix<int> &smat, tup_matrix &tmat,
+                  const std::vector<char> &s, const std::vector<char> &t)
+        : smat_(smat), tmat_(tmat), s_(s), t_(t) {
+        for (int k = 0; k < NSTRIPES; k++)
+            th_[k] = std::thread(&StripeWorkers::work, this, k);
+    }
 
-    auto cell = tmat(get<0>(p), get<1>(p));
+    ~StripeWorkers() {
+        for (int k = 0; k < NSTRIPES; k++) {
+            std::lock_guard<std::mutex> lock(slot_[k].mtx);
+            slot_[k].quit = true;
+            slot_[k].cv.notify_one();
+        }
+        for (int k = 0; k < NSTRIPES; k++)
+            th_[k].join();
+    }
 
-    while (cell != make_tuple(0, 0)) {
-       route.push_back(cell);
-       cell = tmat(get<0>(cell), get<1>(cell)); 
+        // SmithWaterman() for (row, col) on its stripe's thread
+    void run(int row, int col) {
+        Slot &sl = slot_[stripeOf(col, t_.size())];
+        std::unique_lock<std::mutex> lock(sl.mtx);
+        sl.row = row;
+        sl.col = col;
+        sl.busy = true;
+        sl.cv.notify_one();
+        sl.cv.wait(lock, [&] { return ! sl.busy; });
     }
 
-    std::reverse(route.begin(), route.end());
+private:
+    struct Slot {
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool busy = false;  // a cell is handed over and not done yet
+        bool quit = false;
+        int row, col;
+    };
+
+    void work(int stripe) {
+        placeThread(stripe);
+
+        Slot &sl = slot_[stripe];
+        std::unique_lock<std::mutex> lock(sl.mtx);
+        while (true) {
+            sl.cv.wait(lock, [&] { return sl.busy || sl.quit; });
+            if (sl.quit)
+                return;
+            SmithWaterman(smat_, tmat_, s_, t_, sl.row, sl.col);
+            sl.busy = false;
+            sl.cv.notify_one();
+        }
+    }
 
-    for (auto it=route.begin(); it!= route.end(); it++)
-        cout << "[" << get<0>(*it) << ", " << get<1>(*it) << "] ";
-    cout << endl;
+    matrix<int> &smat_;
+    tup_matrix &tmat_;
+    const std::vector<char> &s_;
+    const std::vector<char> &t_;
+    Slot slot_[NSTRIPES];
+    std::thread th_[NSTRIPES];
+};
+
+/*
+ * trace back from the max score p through positive-scoring cells to
+ * where the local alignment begins; prints its start/end cells and a
+ * CIGAR string (M = s/t pair, I = t only, D = s only)
+ */
+void traceback(const matrix<int> &smat, const tup_matrix &tmat,
+               const tuple<int, int> &p) {
+    std::vector<pair<char, int>> ops;     // run-length, back to front
+    int row = get<0>(p);
+    int col = get<1>(p);
+    int beg_row = 0;
+    int beg_col = 0;
+
+    while (smat(row, col) > 0) {
+        beg_row = row;
+        beg_col = col;
+
+        auto src = tmat(row, col);
+        char op = (get<0>(src) == row) ? 'I' : (get<1>(src) == col) ? 'D' : 'M';
+        if (! ops.empty() && ops.back().first == op)
+            ops.back().second++;
+        else
+            ops.push_back(make_pair(op, 1));
+
+        row = get<0>(src);
+        col = get<1>(src);
+    }
+
+    string cigar;
+    for (auto it = ops.rbegin(); it != ops.rend(); it++)
+        cigar += to_string(it->second) + it->first;
+    if (cigar.empty())
+        cigar = "*";
+
+    if (ops.empty())
+        cout << "start: [0, 0]  end: [0, 0]\n";
+    else
+        cout << "start: [" << beg_row << ", " << beg_col << "]  end: ["
+             << get<0>(p) << ", " << get<1>(p) << "]\n";
+    cout << "cigar: " << cigar << endl;
 }
 
 /*
  * main program
  */
 int main(int argc, char* argv[]) {
+    if (argc == 4 && string(argv[1]) == "--pin") {
+        pin_threads = true;
+        argv++;
+        argc--;
+    }
     if (argc != 3) {
-        cerr << "usage: align sequence_file unknown_file\n";
+        cerr << "usage: align [--pin] sequence_file unknown_file\n";
         exit(-1);
     }
 
@@ -340,18 +607,15 @@ int main(int argc, char* argv[]) {
     cout << "\n UNKNOWN(T): " << unkFilNam << " size: " << t.size();
     // printSeq(t);
 
-        // create and zero-out similarity matrix
+        // create similarity and traceback() tuple matrices; pages stay
+        // untouched until the stripe threads place them
     matrix<int> sim_mat(s.size() + 1, t.size() + 1);
-    sim_mat.clear();
-
-        // create and zero-out traceback() tuple matrix
-    matrix<tuple<int, int>> tup_mat(s.size() + 1, t.size() + 1);
-    tup_mat.clear();
+    tup_matrix tup_mat(s.size() + 1, t.size() + 1);
+    initStripeCpus();
+    firstTouchInit(sim_mat, tup_mat);
 
-        // mark sim. matrix cells as not ready (except row, col = 0) 
-    for (int i = 1; i <= s.size(); i++)
-        for (int j = 1; j <= t.size(); j++)
-            sim_mat(i, j) = -999;
+        // readiness lives in the scheduler, not the data: a cell is
+        // pushed onto the readyqueue only once the cells it reads are done
 
         // main task:
         // kick off multi-threaded sequence
@@ -361,6 +625,7 @@ int main(int argc, char* argv[]) {
     int col = 1;
     auto seed = make_pair(row, col);
 
+    StripeWorkers workers(sim_mat, tup_mat, s, t);
     rq.push(seed);
     while (! rq.empty()) {
         
@@ -371,7 +636,7 @@ int main(int argc, char* argv[]) {
             rq.pop();
         rq_mutex.unlock();
     
-        threadedSW(sim_mat, tup_mat, s, t, row, col);
+        workers.run(row, col);
     }
 
     // cout << endl;
@@ -388,9 +653,10 @@ int main(int argc, char* argv[]) {
     double elapsed = tmr.elapsed();
     cout << "\n** multi-threaded readyqueue**" << endl;
     cout << "elapsed time: " << elapsed << " seconds." << endl;
+    printPlacement(t.size());
 
         // print the traceback path
     auto maxop = make_tuple(get<1>(tup), get<2>(tup));
     cout << "\ntraceback:" << endl;
-    traceback(tup_mat, maxop);
+    traceback(sim_mat, tup_mat, maxop);
 }
\ No newline at end of file
@@ -7,19 +7,29 @@
  * CIS 677, F2017
  * Wolffe
  * --
- * multi-threaded rowchunk cascade version
+ * multi-threaded column-stripe pipeline version
 */
 
 
 #include <iostream>
+#include <string>
 #include <fstream>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <queue>
 #include <chrono>
 #include <utility>
 #include <algorithm>
+#include <set>
+#include <cstring>
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/io.hpp>
 
@@ -51,6 +61,183 @@ private:
     std::chrono::time_point<clock_> beg_;
 };
 
+/*
+ * allocator that leaves element construction to whoever first writes
+ * it, so matrix pages are first-touched (and NUMA-placed) by the stripe
+ * threads of firstTouchInit() instead of by main()
+ */
+template <class T>
+struct first_touch_allocator : std::allocator<T> {
+    template <class U> struct rebind { typedef first_touch_allocator<U> other; };
+
+    first_touch_allocator() {}
+    template <class U> first_touch_allocator(const first_touch_allocator<U> &) {}
+
+    template <class U, class... Args> void construct(U *, Args &&...) {}
+};
+
+typedef matrix<tuple<int, int>, row_major,
+               unbounded_array<tuple<int, int>, first_touch_allocator<tuple<int, int>>>> tup_matrix;
+
+/*
+ * column stripes: stripe k owns columns [k*n/NSTRIPES + 1, (k+1)*n/NSTRIPES]
+ * of every row (one worker walks each down all of s), and is placed on
+ * the k-th contiguous group of CPUs ordered by NUMA node
+ */
+#define NSTRIPES 4
+
+bool pin_threads = false;                   // --pin
+std::vector<std::vector<int>> stripe_cpus;  // CPU group per stripe
+
+std::mutex placement_mutex;
+std::set<int> placement_cpus[NSTRIPES];     // where stripe work actually ran
+std::set<int> placement_nodes[NSTRIPES];
+
+/*
+ * NUMA node of a CPU, from sysfs (0 if unknown)
+ * returns: [int]
+ */
+int cpuNode(int cpu) {
+    string path = "/sys/devices/system/cpu/cpu" + to_string(cpu);
+    DIR *dir = opendir(path.c_str());
+    int node = 0;
+    if (dir) {
+        while (struct dirent *ent = readdir(dir))
+            if (strncmp(ent->d_name, "node", 4) == 0 && isdigit(ent->d_name[4]))
+                node = atoi(ent->d_name + 4);
+        closedir(dir);
+    }
+
+    return node;
+}
+
+/*
+ * split the CPUs this process may run on into NSTRIPES node-ordered groups
+ */
+void initStripeCpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    sched_getaffinity(0, sizeof(set), &set);
+
+    std::vector<pair<int, int>> cpus;   // (node, cpu)
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &set))
+            cpus.push_back(make_pair(cpuNode(c), c));
+    std::sort(cpus.begin(), cpus.end());
+
+    int n = cpus.size();
+    stripe_cpus.assign(NSTRIPES, std::vector<int>());
+    for (int k = 0; k < NSTRIPES; k++) {
+        for (int c = k * n / NSTRIPES; c < (k + 1) * n / NSTRIPES; c++)
+            stripe_cpus[k].push_back(cpus[c].second);
+        if (stripe_cpus[k].empty())
+            stripe_cpus[k].push_back(cpus[k % n].second);
+    }
+}
+
+/*
+ * stripe owning a column
+ * returns: [int]
+ */
+int stripeOf(int col, int n) {
+    for (int k = NSTRIPES - 1; k > 0; k--)
+        if (k * n / NSTRIPES + 1 <= col)
+            return k;
+
+    return 0;
+}
+
+/*
+ * called at the start of stripe work: pin the calling thread to its
+ * stripe's CPU group (with --pin) and record where it runs
+ */
+void placeThread(int stripe) {
+    if (pin_threads) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : stripe_cpus[stripe])
+            CPU_SET(c, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    unsigned cpu = 0, node = 0;
+    syscall(SYS_getcpu, &cpu, &node, nullptr);
+
+    placement_mutex.lock();
+        placement_cpus[stripe].insert(cpu);
+        placement_nodes[stripe].insert(node);
+    placement_mutex.unlock();
+}
+
+/*
+ * first-touch, from the calling thread, every page of mat's storage
+ * whose first element lies in stripe's columns (column 0 counts as
+ * stripe 0's).  when a row is narrower than a page, a page holds cells
+ * of every stripe and can only live on one node: pages then spread
+ * over the stripes in proportion to their columns, rather than all
+ * landing on one node.  a zero byte is harmless: nothing reads a cell
+ * before it is written
+ */
+template <class M>
+void touchPages(M &mat, int stripe) {
+    char *base = (char *) &mat.data()[0];
+    size_t elem = sizeof(typename M::value_type);
+    size_t bytes = mat.size1() * mat.size2() * elem;
+    size_t page = sysconf(_SC_PAGESIZE);
+    int n = mat.size2() - 1;
+
+        // the partial page before the first boundary is already mapped
+    for (size_t off = (page - (uintptr_t) base % page) % page; off < bytes; off += page) {
+        int col = (off / elem) % mat.size2();
+        if (stripeOf(std::max(col, 1), n) == stripe)
+            base[off] = 0;
+    }
+}
+
+/*
+ * place a stripe's share of both matrices' pages from a thread placed
+ * on that stripe
+ */
+void touchStripe(matrix<int> &smat, tup_matrix &tmat, int stripe) {
+    placeThread(stripe);
+    touchPages(smat, stripe);
+    touchPages(tmat, stripe);
+}
+
+/*
+ * place matrix pages stripe-parallel, then zero the similarity border
+ * (row, col = 0); its pages are placed by then, so main() may write it
+ */
+void firstTouchInit(matrix<int> &smat, tup_matrix &tmat) {
+    std::thread th[NSTRIPES];
+    for (int k = 0; k < NSTRIPES; k++)
+        th[k] = std::thread(touchStripe, std::ref(smat), std::ref(tmat), k);
+    for (int k = 0; k < NSTRIPES; k++)
+        th[k].join();
+
+    for (int j = 0; j < (int) smat.size2(); j++)
+        smat(0, j) = 0;
+    for (int i = 1; i < (int) smat.size1(); i++)
+        smat(i, 0) = 0;
+}
+
+/*
+ * print the column range, CPUs and NUMA nodes each stripe ran on
+ */
+void printPlacement(int n) {
+    cout << "thread placement (" << (pin_threads ? "pinned" : "unpinned") << "):" << endl;
+    for (int k = 0; k < NSTRIPES; k++) {
+        cout << "  stripe " << k << " cols [" << k * n / NSTRIPES + 1 << ", "
+             << (k + 1) * n / NSTRIPES << "]  cpus";
+        for (int c : placement_cpus[k])
+            cout << " " << c;
+        cout << "  nodes";
+        for (int nd : placement_nodes[k])
+            cout << " " << nd;
+        cout << endl;
+    }
+}
+
 /* 
  * import a nucleotide sequence file
  * returns: [vector<char>]
@@ -88,7 +275,7 @@ void printSimMatrix(const matrix<int> &mat) {
 /*
  * print a uBLAS matrix<tup<int, int>> (tuple)
  */
-void printTupMatrix(const matrix<tuple<int, int>> &mat) {
+void printTupMatrix(const tup_matrix &mat) {
     for (int i = 0; i < mat.size1(); i++) {
         for (int j = 0; j < mat.size2(); j++) {
             auto tup = mat(i, j);
@@ -204,7 +391,7 @@ tuple<int, int> source(int idx, int row, int col) {
  * update Smith-Waterman score for each sim. matrix (smat) cell;
  * also update source for each score in tuple matrix (tmat)
  */
-void SmithWaterman(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
+void SmithWaterman(matrix<int> &smat, tup_matrix &tmat,
                    const std::vector<char> &s,
                    const std::vector<char> &t,
                 //    std::queue<tuple<int, int>> &rq,
@@ -233,7 +420,8 @@ void SmithWaterman(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
         
         // get top score index; update tuple matrix with source() 
     int  top_index = distance(scores.begin(), top_score);
-    tmat(row, col) = source(top_index, row, col);
+        // construct in place: first_touch_allocator left the storage raw
+    new (&tmat(row, col)) tuple<int, int>(source(top_index, row, col));
 }
 
 /*
@@ -264,7 +452,7 @@ tuple<int, int, int> maxScore(const matrix<int> &smat) {
 /*
  * wrap SmithWaterman() in a thread-join. 
  */ 
-void threadedSW(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
+void threadedSW(matrix<int> &smat, tup_matrix &tmat,
                 const std::vector<char> &s,
                 const std::vector<char> &t,
                 int row, int col) {
@@ -275,69 +463,120 @@ void threadedSW(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
 }
 
 /*
- * SmithWaterman() in a row chunk wrapper, given a starting pair
- * and ending pair in the same row, S-W is calculated only for
- * those cells in that row.  data dependency on row above.
+ * rows of s a stripe has finished.  a waiter spins on the counter for
+ * up to SPIN_LIMIT polls (the left neighbor is usually a few cells
+ * behind), then parks on the condition variable; publish() only takes
+ * the lock when someone is parked
  */
-void rowChunkSW(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
-                const std::vector<char> &s,
-                const std::vector<char> &t,
-                const pair<int, int> &beg, const pair<int, int> &end) {
+#define SPIN_LIMIT 4096
 
-    if (beg.first != end.first) {
-        cerr << "\nrowChunkSW() error: this operation must stay on the same row.\n";
-        exit(-1); 
+struct RowProgress {
+    std::atomic<int> rows;
+    std::atomic<bool> parked;
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    RowProgress() : rows(0), parked(false) {}
+
+    void publish(int row) {
+        rows.store(row);
+        if (parked.load()) {
+            { std::lock_guard<std::mutex> lock(mtx); }
+            cv.notify_one();
+        }
     }
 
-        // e.g [1, 1] -> [1, 10]
-    for (int i = beg.first; i == end.first; i++)
-        for (int j = beg.second; j <= end.second; j++)
-            SmithWaterman(smat, tmat, s, t, i, j); 
-} 
+    void waitFor(int row) {
+        for (int k = 0; k < SPIN_LIMIT; k++)
+            if (rows.load(std::memory_order_acquire) >= row)
+                return;
+
+        std::unique_lock<std::mutex> lock(mtx);
+        parked.store(true);
+        cv.wait(lock, [&] { return rows.load() >= row; });
+        parked.store(false);
+    }
+};
 
 /*
- * rowChunkSW() in a wrapper returning a thread
- * returns: [std::thread]
+ * one stripe's worker: walk every row of s over the stripe's columns.
+ * row i's leftmost cells read row i and i - 1 of the left neighbor's
+ * last column, so the worker waits only for that neighbor to finish
+ * row i, never on a barrier for the whole row
  */
-std::thread th_rowChunkSW(matrix<int> &smat, matrix<tuple<int, int>> &tmat,
-                          const std::vector<char> &s,
-                          const std::vector<char> &t,
-                          const pair<int, int> &beg, const pair<int, int> &end) {
+void stripeSW(matrix<int> &smat, tup_matrix &tmat,
+              const std::vector<char> &s,
+              const std::vector<char> &t,
+              int stripe, RowProgress *progress) {
+
+    placeThread(stripe);
 
-    std::thread th(rowChunkSW, std::ref(smat), std::ref(tmat), 
-                  std::ref(s), std::ref(t), std::ref(beg), std::ref(end));
+    int n = t.size();
+    int beg = stripe * n / NSTRIPES + 1;
+    int end = (stripe + 1) * n / NSTRIPES;
 
-    return th;
+    for (int i = 1; i <= (int) s.size(); i++) {
+        if (stripe > 0)
+            progress[stripe - 1].waitFor(i);
+        for (int j = beg; j <= end; j++)
+            SmithWaterman(smat, tmat, s, t, i, j);
+        progress[stripe].publish(i);
+    }
 }
 
 /*
- * trace back the path from [0, 0] to the max score
- * prints: [vector of cell coordinates]
+ * trace back from the max score p through positive-scoring cells to
+ * where the local alignment begins; prints its start/end cells and a
+ * CIGAR string (M = s/t pair, I = t only, D = s only)
  */
-void traceback(const matrix<tuple<int, int>> &tmat, const tuple<int, int> &p) {
-    std::vector<tuple<int, int>> route;
-    route.push_back(p);
-
-    auto cell = tmat(get<0>(p), get<1>(p));
-
-    while (cell != make_tuple(0, 0)) {
-       route.push_back(cell);
-       cell = tmat(get<0>(cell), get<1>(cell)); 
+void traceback(const matrix<int> &smat, const tup_matrix &tmat,
+               const tuple<int, int> &p) {
+    std::vector<pair<char, int>> ops;     // run-length, back to front
+    int row = get<0>(p);
+    int col = get<1>(p);
+    int beg_row = 0;
+    int beg_col = 0;
+
+    while (smat(row, col) > 0) {
+        beg_row = row;
+        beg_col = col;
+
+        auto src = tmat(row, col);
+        char op = (get<0>(src) == row) ? 'I' : (get<1>(src) == col) ? 'D' : 'M';
+        if (! ops.empty() && ops.back().first == op)
+            ops.back().second++;
+        else
+            ops.push_back(make_pair(op, 1));
+
+        row = get<0>(src);
+        col = get<1>(src);
     }
 
-    std::reverse(route.begin(), route.end());
+    string cigar;
+    for (auto it = ops.rbegin(); it != ops.rend(); it++)
+        cigar += to_string(it->second) + it->first;
+    if (cigar.empty())
+        cigar = "*";
 
-    for (auto it=route.begin(); it!= route.end(); it++)
-        cout << "[" << get<0>(*it) << ", " << get<1>(*it) << "] ";
-    cout << endl;
+    if (ops.empty())
+        cout << "start: [0, 0]  end: [0, 0]\n";
+    else
+        cout << "start: [" << beg_row << ", " << beg_col << "]  end: ["
+             << get<0>(p) << ", " << get<1>(p) << "]\n";
+    cout << "cigar: " << cigar << endl;
 }
 
 /*
  * main program
  */
 int main(int argc, char* argv[]) {
+    if (argc == 4 && string(argv[1]) == "--pin") {
+        pin_threads = true;
+        argv++;
+        argc--;
+    }
     if (argc != 3) {
-        cerr << "usage: align sequence_file unknown_file\n";
+        cerr << "usage: align [--pin] sequence_file unknown_file\n";
         exit(-1);
     }
 
@@ -361,81 +600,25 @@ int main(int argc, char* argv[]) {
     cout << "\n UNKNOWN(T): " << unkFilNam << " size: " << t.size();
     // printSeq(t);
 
-        // create and zero-out similarity matrix
+        // create similarity and traceback() tuple matrices; pages stay
+        // untouched until the stripe threads place them
     matrix<int> sim_mat(s.size() + 1, t.size() + 1);
-    sim_mat.clear();
-
-        // create and zero-out traceback() tuple matrix
-    matrix<tuple<int, int>> tup_mat(s.size() + 1, t.size() + 1);
-    tup_mat.clear();
-
-        // mark sim. matrix cells as not ready (except row, col = 0) 
-    for (int i = 1; i <= s.size(); i++)
-        for (int j = 1; j <= t.size(); j++)
-            sim_mat(i, j) = -999;
+    tup_matrix tup_mat(s.size() + 1, t.size() + 1);
+    initStripeCpus();
+    firstTouchInit(sim_mat, tup_mat);
 
         // main task:
-        // using modular arithmetic allocate multiple threads per row
-        // 1st row 1 thread; 2nd row 2 threads; 3rd row 4 threads
-        // only works for rows evenly divisible by the smallest chunk:
-        // case 0: -> (48 / 4 = 12)
-
-        // declare start/finish pairs; threads 
-    pair<int, int> beg_pair1, beg_pair2, beg_pair3, beg_pair4;
-    pair<int, int> end_pair1, end_pair2, end_pair3, end_pair4;
-    std::thread t1, t2, t3, t4;
-
-    for (int i = 1; i <= s.size(); i++) {
-        switch (i % 3) {
-            case 1: {
-                beg_pair1 = make_pair(i, 1);
-                end_pair1 = make_pair(i, t.size());
-                
-                std::thread t1 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair1, end_pair1);
-                
-                t1.join();
-                break;
-            }
-            case 2: {
-                beg_pair1 = make_pair(i, 1);
-                end_pair1 = make_pair(i, (int) t.size()/2);
-                
-                beg_pair2 = make_pair(i, (int) t.size()/2 + 1);
-                end_pair2 = make_pair(i, t.size());
-                
-                t1 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair1, end_pair1); 
-                t2 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair2, end_pair2);
-
-                t1.join();
-                t2.join();
-                break;
-            }
-            case 0: {
-                beg_pair1 = make_pair(i, 1);
-                end_pair1 = make_pair(i, (int) t.size()/4);
-                
-                beg_pair2 = make_pair(i, (int) t.size()/4 + 1);
-                end_pair2 = make_pair(i, (int) t.size()/2);
-                
-                beg_pair3 = make_pair(i, (int) t.size()/2 + 1);
-                end_pair3 = make_pair(i, (int) t.size() * 3/4);
-                
-                beg_pair4 = make_pair(i, (int) t.size() * 3/4 + 1);
-                end_pair4 = make_pair(i, (int) t.size());
-                
-                t1 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair1, end_pair1);
-                t2 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair2, end_pair2);
-                t3 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair3, end_pair3);
-                t4 = th_rowChunkSW(sim_mat, tup_mat, s, t, beg_pair4, end_pair4);
-
-                t1.join();
-                t2.join();
-                t3.join();
-                t4.join();
-                break;
-            }
-        }
-    } 
+        // one worker per column stripe for the whole run, each a row
+        // behind its left neighbor at most; readiness lives in the
+        // per-stripe row counters, so there is no per-row join.  any
+        // t.size() works: a stripe may be empty and just passes rows on
+    RowProgress progress[NSTRIPES];
+    std::thread workers[NSTRIPES];
+    for (int k = 0; k < NSTRIPES; k++)
+        workers[k] = std::thread(stripeSW, std::ref(sim_mat), std::ref(tup_mat),
+                                 std::cref(s), std::cref(t), k, progress);
+    for (int k = 0; k < NSTRIPES; k++)
+        workers[k].join();
 
     // cout << endl;
     // printSimMatrix(sim_mat);
@@ -449,11 +632,12 @@ int main(int argc, char* argv[]) {
    
         // stop the timer
     double elapsed = tmr.elapsed();
-    cout << "\n** multi-threaded rowchunk cascade**" << endl;
+    cout << "\n** multi-threaded column-stripe pipeline **" << endl;
     cout << "elapsed time: " << elapsed << " seconds." << endl;
+    printPlacement(t.size());
 
         // print the traceback path
     auto maxop = make_tuple(get<1>(tup), get<2>(tup));
     cout << "\ntraceback:" << endl;
-    traceback(tup_mat, maxop);
+    traceback(sim_mat, tup_mat, maxop);
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * alignsw.h: C interface to the alignment engines in align.cpp, built
+ * as libalignsw.so with `make lib` (align.cpp compiled with
+ * -DALIGNSW_LIBRARY).  sequences are passed as pointer + length and
+ * read in place; results go to caller-provided buffers.  calls are
+ * independent and may be made from several threads at once
+ */
+#ifndef ALIGNSW_H
+#define ALIGNSW_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALIGNSW_VERSION 1
+
+    /* engines */
+#define ALIGNSW_ENGINE_AUTO        0    /* local alignment, best available fill */
+#define ALIGNSW_ENGINE_SIMD        1    /* anti-diagonal SIMD fill (int16 scores) */
+#define ALIGNSW_ENGINE_EDIT        2    /* unit-cost edit distance, bit-vector */
+#define ALIGNSW_ENGINE_EDIT_SCALAR 3    /* unit-cost edit distance, scalar DP */
+
+    /* return codes */
+#define ALIGNSW_OK          0
+#define ALIGNSW_E_ARG      -1   /* null pointer or unknown engine */
+#define ALIGNSW_E_SCORING  -2   /* scoring parameters out of range */
+#define ALIGNSW_E_RANGE    -3   /* scores could overflow the engine's lanes */
+#define ALIGNSW_E_CIGAR    -4   /* CIGAR buffer too small; cigar_len holds the need */
+#define ALIGNSW_E_MEMORY   -5
+
+/*
+ * local-alignment scoring: +match for equal characters ('?' matches
+ * anything), -mismatch otherwise, -gap per inserted or deleted one.
+ * all three in 0..1000, match at least 1.  the edit engines ignore it
+ */
+typedef struct {
+    int match;
+    int mismatch;
+    int gap;
+} alignsw_scoring;
+
+/*
+ * one alignment: 1-based first and last rows (s) and cols (t), all
+ * zero when nothing scored.  score is the distance for the edit
+ * engines.  cigar_len is the CIGAR's length without its terminating
+ * NUL, "*" when empty
+ */
+typedef struct {
+    int score;
+    int s_beg, s_end;
+    int t_beg, t_end;
+    size_t cigar_len;
+} alignsw_result;
+
+/*
+ * the default scoring of the align program
+ */
+alignsw_scoring alignsw_default_scoring(void);
+
+/*
+ * align t against s with engine; scoring may be NULL for the default.
+ * the CIGAR is written NUL-terminated to cigar when it fits in
+ * cigar_cap bytes (cigar may be NULL when cigar_cap is 0)
+ * returns: ALIGNSW_OK or a negative ALIGNSW_E_* code
+ */
+int alignsw_align(const char *s, size_t s_len, const char *t, size_t t_len,
+                  const alignsw_scoring *scoring, int engine,
+                  alignsw_result *result, char *cigar, size_t cigar_cap);
+
+/*
+ * a message for a return code of alignsw_align()
+ */
+const char *alignsw_strerror(int code);
+
+/*
+ * ALIGNSW_VERSION of the library actually loaded
+ */
+int alignsw_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif